@@ -160,6 +160,13 @@ static void s3c64xx_dma_fill_lli(struct s3c2410_dma_chan *chan,
 		control0 = PL080_CONTROL_DST_AHB2;
 		control0 |= PL080_CONTROL_SRC_INCR;
 		break;
+
+	case S3C2410_DMASRC_MEM2MEM:
+		/* source is a fixed data port, such as a FIFO window */
+		src = chan->dev_addr;
+		dst = data;
+		control0 = PL080_CONTROL_DST_INCR;
+		break;
 	default:
 		BUG();
 	}
@@ -444,6 +451,9 @@ int s3c2410_dma_devconfig(unsigned int channel,
 		config = 1 << PL080_CONFIG_FLOW_CONTROL_SHIFT;
 		config |= peripheral << PL080_CONFIG_DST_SEL_SHIFT;
 		break;
+	case S3C2410_DMASRC_MEM2MEM:
+		config = PL080_FLOW_MEM2MEM << PL080_CONFIG_FLOW_CONTROL_SHIFT;
+		break;
 	default:
 		printk(KERN_ERR "%s: bad source\n", __func__);
 		return -EINVAL;
@@ -55,6 +55,7 @@ enum dma_ch {
 	DMACH_RES2,
 	DMACH_SECURITY_RX,	/* SDMA1 only */
 	DMACH_SECURITY_TX,	/* SDMA1 only */
+	DMACH_ONENAND_IN,	/* DMA1, memory to memory, no request line */
 	DMACH_MAX		/* the end */
 };
 
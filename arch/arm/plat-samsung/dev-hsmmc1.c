@@ -60,6 +60,7 @@ void s3c_sdhci1_set_platdata(struct s3c_sdhci_platdata *pd)
 	struct s3c_sdhci_platdata *set = &s3c_hsmmc1_def_platdata;
 
 	set->max_width = pd->max_width;
+	set->auto_cmd12 = pd->auto_cmd12;
 
 	if (pd->cfg_gpio)
 		set->cfg_gpio = pd->cfg_gpio;
@@ -18,7 +18,8 @@ enum s3c2410_dma_buffresult {
 
 enum s3c2410_dmasrc {
 	S3C2410_DMASRC_HW,		/* source is memory */
-	S3C2410_DMASRC_MEM		/* source is hardware */
+	S3C2410_DMASRC_MEM,		/* source is hardware */
+	S3C2410_DMASRC_MEM2MEM		/* fixed memory port to memory */
 };
 
 /* enum s3c2410_chan_op
@@ -76,6 +76,53 @@ static void drive_stat_acct(struct request *rq, int new_io)
 	part_stat_unlock();
 }
 
+#ifdef CONFIG_BLK_DEV_LATENCY_HIST
+static inline int blk_latency_bucket(u64 start, u64 end)
+{
+	int bucket;
+
+	if (unlikely(end < start))
+		return 0;
+
+	bucket = fls64((end - start) >> 10);
+	return min(bucket, BLK_LATENCY_BUCKETS - 1);
+}
+
+/*
+ * called with the queue lock held when the driver takes the request
+ */
+static void blk_latency_dispatch(struct request *rq)
+{
+	struct request_queue *q = rq->q;
+
+	q->latency_hist.queue[blk_latency_bucket(rq_start_time_ns(rq),
+						 rq_io_start_time_ns(rq))]++;
+}
+
+/*
+ * called with the queue lock held when the request is finished
+ */
+static void blk_latency_done(struct request *rq)
+{
+	struct blk_latency_hist *hist = &rq->q->latency_hist;
+	u64 now;
+
+	/* never went through blk_dequeue_request, or is the barrier proxy */
+	if (!rq_io_start_time_ns(rq) || rq == &rq->q->bar_rq)
+		return;
+
+	preempt_disable();
+	now = sched_clock();
+	preempt_enable();
+
+	hist->dispatch[blk_latency_bucket(rq_io_start_time_ns(rq), now)]++;
+	hist->complete[blk_latency_bucket(rq_start_time_ns(rq), now)]++;
+}
+#else
+static inline void blk_latency_dispatch(struct request *rq) {}
+static inline void blk_latency_done(struct request *rq) {}
+#endif
+
 void blk_queue_congestion_threshold(struct request_queue *q)
 {
 	int nr;
@@ -214,6 +261,7 @@ void blk_plug_device(struct request_queue *q)
 
 	if (!queue_flag_test_and_set(QUEUE_FLAG_PLUGGED, q)) {
 		mod_timer(&q->unplug_timer, jiffies + q->unplug_delay);
+		blk_latency_inc(q, plugs);
 		trace_block_plug(q);
 	}
 }
@@ -263,6 +311,7 @@ void __generic_unplug_device(struct request_queue *q)
 	if (!blk_remove_plug(q) && !blk_queue_nonrot(q))
 		return;
 
+	blk_latency_inc(q, unplugs);
 	q->request_fn(q);
 }
 
@@ -1223,6 +1272,7 @@ static int __make_request(struct request_queue *q, struct bio *bio)
 		if (!blk_rq_cpu_valid(req))
 			req->cpu = bio->bi_comp_cpu;
 		drive_stat_acct(req, 0);
+		blk_latency_inc(q, bio_merges);
 		elv_bio_merged(q, req, bio);
 		if (!attempt_back_merge(q, req))
 			elv_merged_request(q, req, el_ret);
@@ -1257,6 +1307,7 @@ static int __make_request(struct request_queue *q, struct bio *bio)
 		if (!blk_rq_cpu_valid(req))
 			req->cpu = bio->bi_comp_cpu;
 		drive_stat_acct(req, 0);
+		blk_latency_inc(q, bio_merges);
 		elv_bio_merged(q, req, bio);
 		if (!attempt_front_merge(q, req))
 			elv_merged_request(q, req, el_ret);
@@ -1297,6 +1348,7 @@ get_rq:
 		req->cpu = blk_cpu_to_group(smp_processor_id());
 	if (queue_should_plug(q) && elv_queue_empty(q))
 		blk_plug_device(q);
+	blk_latency_inc(q, requests);
 	add_request(q, req);
 out:
 	if (unplug || !queue_should_plug(q))
@@ -1886,6 +1938,7 @@ void blk_dequeue_request(struct request *rq)
 	if (blk_account_rq(rq)) {
 		q->in_flight[rq_is_sync(rq)]++;
 		set_io_start_time_ns(rq);
+		blk_latency_dispatch(rq);
 	}
 }
 
@@ -2133,6 +2186,7 @@ static void blk_finish_request(struct request *req, int error)
 	blk_delete_timer(req);
 
 	blk_account_io_done(req);
+	blk_latency_done(req);
 
 	if (req->end_io)
 		req->end_io(req, error);
@@ -418,6 +418,7 @@ static int attempt_merge(struct request_queue *q, struct request *req,
 	 * 'next' is going away, so update stats accordingly
 	 */
 	blk_account_io_merge(next);
+	blk_latency_inc(q, rq_merges);
 
 	req->ioprio = ioprio_best(req->ioprio, next->ioprio);
 	if (blk_rq_cpu_valid(next))
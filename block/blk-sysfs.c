@@ -271,6 +271,74 @@ static ssize_t queue_iostats_store(struct request_queue *q, const char *page,
 	return ret;
 }
 
+#ifdef CONFIG_BLK_DEV_LATENCY_HIST
+/*
+ * One line per bucket: the bucket's upper bound in usecs, then the
+ * number of requests in it for queue, dispatch and complete latency.
+ */
+static ssize_t queue_latency_hist_show(struct request_queue *q, char *page)
+{
+	struct blk_latency_hist *hist = &q->latency_hist;
+	char *p = page;
+	int i;
+
+	p += sprintf(p, "%10s %10s %10s %10s\n",
+		     "usecs", "queue", "dispatch", "complete");
+	for (i = 0; i < BLK_LATENCY_BUCKETS; i++) {
+		if (i < BLK_LATENCY_BUCKETS - 1)
+			p += sprintf(p, "<%9llu", div_u64(1024ULL << i, 1000));
+		else
+			p += sprintf(p, "%10s", "more");
+		p += sprintf(p, " %10lu %10lu %10lu\n", hist->queue[i],
+			     hist->dispatch[i], hist->complete[i]);
+	}
+
+	return p - page;
+}
+
+static ssize_t
+queue_latency_hist_store(struct request_queue *q, const char *page,
+			 size_t count)
+{
+	struct blk_latency_hist *hist = &q->latency_hist;
+
+	spin_lock_irq(q->queue_lock);
+	memset(hist->queue, 0, sizeof(hist->queue));
+	memset(hist->dispatch, 0, sizeof(hist->dispatch));
+	memset(hist->complete, 0, sizeof(hist->complete));
+	spin_unlock_irq(q->queue_lock);
+
+	return count;
+}
+
+static ssize_t queue_batch_stats_show(struct request_queue *q, char *page)
+{
+	struct blk_latency_hist *hist = &q->latency_hist;
+
+	return sprintf(page, "requests %lu\nbio_merges %lu\nrq_merges %lu\n"
+		       "plugs %lu\nunplugs %lu\n", hist->requests,
+		       hist->bio_merges, hist->rq_merges, hist->plugs,
+		       hist->unplugs);
+}
+
+static ssize_t
+queue_batch_stats_store(struct request_queue *q, const char *page,
+			size_t count)
+{
+	struct blk_latency_hist *hist = &q->latency_hist;
+
+	spin_lock_irq(q->queue_lock);
+	hist->requests = 0;
+	hist->bio_merges = 0;
+	hist->rq_merges = 0;
+	hist->plugs = 0;
+	hist->unplugs = 0;
+	spin_unlock_irq(q->queue_lock);
+
+	return count;
+}
+#endif
+
 static struct queue_sysfs_entry queue_requests_entry = {
 	.attr = {.name = "nr_requests", .mode = S_IRUGO | S_IWUSR },
 	.show = queue_requests_show,
@@ -374,6 +442,20 @@ static struct queue_sysfs_entry queue_iostats_entry = {
 	.store = queue_iostats_store,
 };
 
+#ifdef CONFIG_BLK_DEV_LATENCY_HIST
+static struct queue_sysfs_entry queue_latency_hist_entry = {
+	.attr = {.name = "latency_hist", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_latency_hist_show,
+	.store = queue_latency_hist_store,
+};
+
+static struct queue_sysfs_entry queue_batch_stats_entry = {
+	.attr = {.name = "batch_stats", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_batch_stats_show,
+	.store = queue_batch_stats_store,
+};
+#endif
+
 static struct attribute *default_attrs[] = {
 	&queue_requests_entry.attr,
 	&queue_ra_entry.attr,
@@ -394,6 +476,10 @@ static struct attribute *default_attrs[] = {
 	&queue_nomerges_entry.attr,
 	&queue_rq_affinity_entry.attr,
 	&queue_iostats_entry.attr,
+#ifdef CONFIG_BLK_DEV_LATENCY_HIST
+	&queue_latency_hist_entry.attr,
+	&queue_batch_stats_entry.attr,
+#endif
 	NULL,
 };
 
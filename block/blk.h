@@ -152,6 +152,12 @@ static inline int blk_cpu_to_group(int cpu)
 #endif
 }
 
+#ifdef CONFIG_BLK_DEV_LATENCY_HIST
+#define blk_latency_inc(q, field)	((q)->latency_hist.field++)
+#else
+#define blk_latency_inc(q, field)	do { } while (0)
+#endif
+
 /*
  * Contribute to IO statistics IFF:
  *
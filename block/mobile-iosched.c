@@ -0,0 +1,423 @@
+/*
+ *  Mobile i/o scheduler.
+ *
+ *  A latency oriented scheduler for flash storage on handsets, derived
+ *  from the deadline scheduler.  Flash does not seek, so there is no
+ *  sector sorting: requests are kept in per-class fifos ordered by
+ *  deadline.  Synchronous reads, which is what the foreground app is
+ *  waiting on, are served first and within a latency budget; writes
+ *  are dispatched in batches so they reach the driver back to back.
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/ioprio.h>
+#include <linux/iocontext.h>
+#include <linux/sched.h>
+
+/*
+ * See Documentation/block/mobile-iosched.txt
+ */
+static const int read_expire = HZ / 20;		/* latency budget of a sync read */
+static const int sync_write_expire = HZ / 2;	/* fsync and O_SYNC writes */
+static const int async_expire = 5 * HZ;		/* writeback and idle class i/o */
+static const int read_batch = 16;		/* max reads dispatched in a row */
+static const int write_batch = 8;		/* max writes dispatched in a row */
+static const int writes_starved = 4;		/* max read batches before writes */
+
+enum {
+	MOBILE_SYNC_READ,
+	MOBILE_SYNC_WRITE,
+	MOBILE_ASYNC,
+	MOBILE_NR_QUEUES,
+};
+
+struct mobile_data {
+	/*
+	 * run time data
+	 */
+
+	/*
+	 * requests are kept on one fifo per queue, in deadline order
+	 */
+	struct list_head fifo_list[MOBILE_NR_QUEUES];
+
+	int cur_queue;			/* queue of the current batch */
+	unsigned int batching;		/* requests dispatched in this batch */
+	unsigned int starved;		/* read batches since the last write */
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int fifo_expire[MOBILE_NR_QUEUES];
+	int read_batch;
+	int write_batch;
+	int writes_starved;
+};
+
+/*
+ * The io priority class of the submitting task is remembered when the
+ * request is allocated, as the request itself only carries an explicit
+ * priority when the bio had one.
+ */
+static int
+mobile_set_request(struct request_queue *q, struct request *rq, gfp_t gfp_mask)
+{
+	struct io_context *ioc = current->io_context;
+	int class;
+
+	if (ioc && ioprio_valid(ioc->ioprio))
+		class = IOPRIO_PRIO_CLASS(ioc->ioprio);
+	else
+		class = task_nice_ioclass(current);
+
+	rq->elevator_private = (void *)(long)class;
+	return 0;
+}
+
+static inline int mobile_rq_class(struct request *rq)
+{
+	if (ioprio_valid(req_get_ioprio(rq)))
+		return IOPRIO_PRIO_CLASS(req_get_ioprio(rq));
+
+	return (long)rq->elevator_private;
+}
+
+/*
+ * Background (idle class) i/o and async writes share the lowest queue.
+ */
+static inline int mobile_rq_queue(struct request *rq, int class)
+{
+	if (class == IOPRIO_CLASS_IDLE || !rq_is_sync(rq))
+		return MOBILE_ASYNC;
+
+	return rq_data_dir(rq) == READ ? MOBILE_SYNC_READ : MOBILE_SYNC_WRITE;
+}
+
+/*
+ * add rq to its fifo, keeping the fifo in deadline order.  Most
+ * requests of a queue share the same expire time, so this normally
+ * stops at the tail.
+ */
+static void
+mobile_add_request(struct request_queue *q, struct request *rq)
+{
+	struct mobile_data *md = q->elevator->elevator_data;
+	const int class = mobile_rq_class(rq);
+	const int queue = mobile_rq_queue(rq, class);
+	struct list_head *fifo = &md->fifo_list[queue];
+	struct list_head *pos;
+	int expire = md->fifo_expire[queue];
+
+	/* realtime i/o gets half the budget of its queue */
+	if (class == IOPRIO_CLASS_RT)
+		expire /= 2;
+
+	rq_set_fifo_time(rq, jiffies + expire);
+
+	list_for_each_prev(pos, fifo) {
+		if (!time_after(rq_fifo_time(rq_entry_fifo(pos)),
+				rq_fifo_time(rq)))
+			break;
+	}
+	list_add(&rq->queuelist, pos);
+}
+
+static void
+mobile_merged_requests(struct request_queue *q, struct request *req,
+		       struct request *next)
+{
+	/*
+	 * if next expires before rq, assign its expire time to rq
+	 * and move into next position (next will be deleted) in fifo
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist)) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+		}
+	}
+
+	/*
+	 * kill knowledge of next, this one is a goner
+	 */
+	rq_fifo_clear(next);
+}
+
+/*
+ * move request from fifo to dispatch queue.
+ */
+static inline void
+mobile_move_to_dispatch(struct mobile_data *md, struct request *rq)
+{
+	rq_fifo_clear(rq);
+	elv_dispatch_add_tail(rq->q, rq);
+}
+
+/*
+ * returns 1 if the oldest request of queue has passed its deadline.
+ * Requires !list_empty(&md->fifo_list[queue])
+ */
+static inline int mobile_check_fifo(struct mobile_data *md, int queue)
+{
+	struct request *rq = rq_entry_fifo(md->fifo_list[queue].next);
+
+	return time_after(jiffies, rq_fifo_time(rq));
+}
+
+static inline int mobile_batch_size(struct mobile_data *md, int queue)
+{
+	return queue == MOBILE_SYNC_READ ? md->read_batch : md->write_batch;
+}
+
+/*
+ * pick the queue to dispatch from, or -1 if there is nothing to do
+ */
+static int mobile_select_queue(struct mobile_data *md)
+{
+	const int reads = !list_empty(&md->fifo_list[MOBILE_SYNC_READ]);
+	const int sync_writes = !list_empty(&md->fifo_list[MOBILE_SYNC_WRITE]);
+	const int async = !list_empty(&md->fifo_list[MOBILE_ASYNC]);
+	const int sync_expired = sync_writes &&
+		mobile_check_fifo(md, MOBILE_SYNC_WRITE);
+	const int async_expired = async &&
+		mobile_check_fifo(md, MOBILE_ASYNC);
+	int queue;
+
+	/*
+	 * a read past its budget goes next, even in the middle of a
+	 * write batch
+	 */
+	if (reads && mobile_check_fifo(md, MOBILE_SYNC_READ)) {
+		queue = MOBILE_SYNC_READ;
+		if (md->cur_queue != queue)
+			goto new_batch;
+		md->starved = 0;
+		return queue;
+	}
+
+	/*
+	 * keep going with the current batch
+	 */
+	queue = md->cur_queue;
+	if (!list_empty(&md->fifo_list[queue]) &&
+	    md->batching < mobile_batch_size(md, queue))
+		return queue;
+
+	/*
+	 * start a new batch: reads unless writes have been starved for
+	 * long enough or one of them has expired
+	 */
+	if ((sync_writes || async) &&
+	    (!reads || md->starved >= md->writes_starved ||
+	     sync_expired || async_expired)) {
+		md->starved = 0;
+		if (async_expired && !sync_expired)
+			queue = MOBILE_ASYNC;
+		else if (sync_writes)
+			queue = MOBILE_SYNC_WRITE;
+		else
+			queue = MOBILE_ASYNC;
+		goto new_batch;
+	}
+
+	if (reads) {
+		if (sync_writes || async)
+			md->starved++;
+		queue = MOBILE_SYNC_READ;
+		goto new_batch;
+	}
+
+	return -1;
+
+new_batch:
+	md->cur_queue = queue;
+	md->batching = 0;
+	return queue;
+}
+
+static int mobile_dispatch_requests(struct request_queue *q, int force)
+{
+	struct mobile_data *md = q->elevator->elevator_data;
+	struct request *rq;
+	int queue, dispatched = 0;
+
+	if (unlikely(force)) {
+		for (queue = 0; queue < MOBILE_NR_QUEUES; queue++) {
+			while (!list_empty(&md->fifo_list[queue])) {
+				rq = rq_entry_fifo(md->fifo_list[queue].next);
+				mobile_move_to_dispatch(md, rq);
+				dispatched++;
+			}
+		}
+		md->batching = 0;
+		return dispatched;
+	}
+
+	queue = mobile_select_queue(md);
+	if (queue < 0)
+		return 0;
+
+	rq = rq_entry_fifo(md->fifo_list[queue].next);
+	md->batching++;
+	mobile_move_to_dispatch(md, rq);
+
+	return 1;
+}
+
+static int mobile_queue_empty(struct request_queue *q)
+{
+	struct mobile_data *md = q->elevator->elevator_data;
+
+	return list_empty(&md->fifo_list[MOBILE_SYNC_READ])
+		&& list_empty(&md->fifo_list[MOBILE_SYNC_WRITE])
+		&& list_empty(&md->fifo_list[MOBILE_ASYNC]);
+}
+
+static void mobile_exit_queue(struct elevator_queue *e)
+{
+	struct mobile_data *md = e->elevator_data;
+	int queue;
+
+	for (queue = 0; queue < MOBILE_NR_QUEUES; queue++)
+		BUG_ON(!list_empty(&md->fifo_list[queue]));
+
+	kfree(md);
+}
+
+/*
+ * initialize elevator private data (mobile_data).
+ */
+static void *mobile_init_queue(struct request_queue *q)
+{
+	struct mobile_data *md;
+	int queue;
+
+	md = kmalloc_node(sizeof(*md), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!md)
+		return NULL;
+
+	for (queue = 0; queue < MOBILE_NR_QUEUES; queue++)
+		INIT_LIST_HEAD(&md->fifo_list[queue]);
+	md->fifo_expire[MOBILE_SYNC_READ] = read_expire;
+	md->fifo_expire[MOBILE_SYNC_WRITE] = sync_write_expire;
+	md->fifo_expire[MOBILE_ASYNC] = async_expire;
+	md->read_batch = read_batch;
+	md->write_batch = write_batch;
+	md->writes_starved = writes_starved;
+	md->cur_queue = MOBILE_SYNC_READ;
+	return md;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+mobile_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+mobile_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct mobile_data *md = e->elevator_data;			\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return mobile_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(mobile_read_expire_show, md->fifo_expire[MOBILE_SYNC_READ], 1);
+SHOW_FUNCTION(mobile_sync_write_expire_show, md->fifo_expire[MOBILE_SYNC_WRITE], 1);
+SHOW_FUNCTION(mobile_async_expire_show, md->fifo_expire[MOBILE_ASYNC], 1);
+SHOW_FUNCTION(mobile_read_batch_show, md->read_batch, 0);
+SHOW_FUNCTION(mobile_write_batch_show, md->write_batch, 0);
+SHOW_FUNCTION(mobile_writes_starved_show, md->writes_starved, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct mobile_data *md = e->elevator_data;			\
+	int __data;							\
+	int ret = mobile_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(mobile_read_expire_store, &md->fifo_expire[MOBILE_SYNC_READ], 0, INT_MAX, 1);
+STORE_FUNCTION(mobile_sync_write_expire_store, &md->fifo_expire[MOBILE_SYNC_WRITE], 0, INT_MAX, 1);
+STORE_FUNCTION(mobile_async_expire_store, &md->fifo_expire[MOBILE_ASYNC], 0, INT_MAX, 1);
+STORE_FUNCTION(mobile_read_batch_store, &md->read_batch, 1, INT_MAX, 0);
+STORE_FUNCTION(mobile_write_batch_store, &md->write_batch, 1, INT_MAX, 0);
+STORE_FUNCTION(mobile_writes_starved_store, &md->writes_starved, 0, INT_MAX, 0);
+#undef STORE_FUNCTION
+
+#define MD_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, mobile_##name##_show, \
+				      mobile_##name##_store)
+
+static struct elv_fs_entry mobile_attrs[] = {
+	MD_ATTR(read_expire),
+	MD_ATTR(sync_write_expire),
+	MD_ATTR(async_expire),
+	MD_ATTR(read_batch),
+	MD_ATTR(write_batch),
+	MD_ATTR(writes_starved),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_mobile = {
+	.ops = {
+		.elevator_merge_req_fn =	mobile_merged_requests,
+		.elevator_dispatch_fn =		mobile_dispatch_requests,
+		.elevator_add_req_fn =		mobile_add_request,
+		.elevator_queue_empty_fn =	mobile_queue_empty,
+		.elevator_set_req_fn =		mobile_set_request,
+		.elevator_init_fn =		mobile_init_queue,
+		.elevator_exit_fn =		mobile_exit_queue,
+	},
+
+	.elevator_attrs = mobile_attrs,
+	.elevator_name = "mobile",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init mobile_init(void)
+{
+	elv_register(&iosched_mobile);
+
+	return 0;
+}
+
+static void __exit mobile_exit(void)
+{
+	elv_unregister(&iosched_mobile);
+}
+
+module_init(mobile_init);
+module_exit(mobile_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Latency oriented IO scheduler for flash");
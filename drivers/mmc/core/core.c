@@ -200,6 +200,86 @@ static void mmc_wait_done(struct mmc_request *mrq)
 	complete(mrq->done_data);
 }
 
+/*
+ * Give the host a chance to prepare (dma map, flush caches) the request
+ * before it is started, and to undo that once it is done.
+ */
+static void mmc_pre_req(struct mmc_host *host, struct mmc_request *mrq,
+			bool is_first_req)
+{
+	if (host->ops->pre_req)
+		host->ops->pre_req(host, mrq, is_first_req);
+}
+
+static void mmc_post_req(struct mmc_host *host, struct mmc_request *mrq,
+			 int err)
+{
+	if (host->ops->post_req)
+		host->ops->post_req(host, mrq, err);
+}
+
+static void __mmc_start_req(struct mmc_host *host, struct mmc_request *mrq)
+{
+	init_completion(&mrq->completion);
+	mrq->done_data = &mrq->completion;
+	mrq->done = mmc_wait_done;
+
+	mmc_start_request(host, mrq);
+}
+
+/**
+ *	mmc_start_req - start a non-blocking request
+ *	@host: MMC host to start command
+ *	@areq: async request to start, or NULL to only wait for the
+ *	       previous one
+ *	@error: out parameter; returns 0 for success, otherwise the
+ *	       error code returned by err_check of the previous request
+ *
+ *	Prepare @areq with the host's pre_req hook while the previously
+ *	started request is still being transferred, then wait for the
+ *	previous request to complete and start @areq.  Returns the
+ *	completed request, or NULL if there was none.
+ *
+ *	If the previous request failed err_check, @areq is not started
+ *	(its preparation is undone) and the caller must issue it again.
+ */
+struct mmc_async_req *mmc_start_req(struct mmc_host *host,
+				    struct mmc_async_req *areq, int *error)
+{
+	struct mmc_async_req *data = host->areq;
+	int err = 0;
+
+	WARN_ON(!host->claimed);
+
+	if (areq)
+		mmc_pre_req(host, areq->mrq, !host->areq);
+
+	if (host->areq) {
+		wait_for_completion(&host->areq->mrq->completion);
+		err = host->areq->err_check(host->card, host->areq);
+		if (err) {
+			mmc_post_req(host, host->areq->mrq, 0);
+			if (areq)
+				mmc_post_req(host, areq->mrq, -EINVAL);
+			host->areq = NULL;
+			goto out;
+		}
+	}
+
+	if (areq)
+		__mmc_start_req(host, areq->mrq);
+
+	if (host->areq)
+		mmc_post_req(host, host->areq->mrq, 0);
+
+	host->areq = areq;
+ out:
+	if (error)
+		*error = err;
+	return data;
+}
+EXPORT_SYMBOL(mmc_start_req);
+
 /**
  *	mmc_wait_for_req - start a request and wait for completion
  *	@host: MMC host to start command
@@ -216,6 +296,10 @@ void mmc_wait_for_req(struct mmc_host *host, struct mmc_request *mrq)
 	mrq->done_data = &complete;
 	mrq->done = mmc_wait_done;
 
+	/* Not prepared through pre_req, don't let the host think so */
+	if (mrq->data)
+		mrq->data->host_cookie = 0;
+
 	mmc_start_request(host, mrq);
 
 	wait_for_completion(&complete);
@@ -335,6 +335,12 @@ static int __devinit sdhci_s3c_probe(struct platform_device *pdev)
 	host->quirks |= (SDHCI_QUIRK_32BIT_DMA_ADDR |
 			 SDHCI_QUIRK_32BIT_DMA_SIZE);
 
+	/* The HSMMC block can issue CMD12 itself at the end of multi-block
+	 * transfers, which saves a command and an interrupt per request.
+	 * Only boards on which this has been verified ask for it. */
+	if (pdata->auto_cmd12)
+		host->quirks |= SDHCI_QUIRK_MULTIBLOCK_AUTO_CMD12;
+
 	ret = sdhci_add_host(host);
 	if (ret) {
 		dev_err(dev, "sdhci_add_host() failed\n");
@@ -21,6 +21,8 @@
 #include <linux/scatterlist.h>
 
 #include <linux/leds.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <linux/mmc/host.h>
 
@@ -439,8 +441,12 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 		goto fail;
 	BUG_ON(host->align_addr & 0x3);
 
-	host->sg_count = dma_map_sg(mmc_dev(host->mmc),
-		data->sg, data->sg_len, direction);
+	/* Already mapped by sdhci_pre_req()? */
+	if (data->host_cookie)
+		host->sg_count = data->host_cookie;
+	else
+		host->sg_count = dma_map_sg(mmc_dev(host->mmc),
+			data->sg, data->sg_len, direction);
 	if (host->sg_count == 0)
 		goto unmap_align;
 
@@ -530,8 +536,9 @@ static int sdhci_adma_table_pre(struct sdhci_host *host,
 	return 0;
 
 unmap_entries:
-	dma_unmap_sg(mmc_dev(host->mmc), data->sg,
-		data->sg_len, direction);
+	if (!data->host_cookie)
+		dma_unmap_sg(mmc_dev(host->mmc), data->sg,
+			data->sg_len, direction);
 unmap_align:
 	dma_unmap_single(mmc_dev(host->mmc), host->align_addr,
 		128 * 4, direction);
@@ -561,6 +568,13 @@ static void sdhci_adma_table_post(struct sdhci_host *host,
 	dma_unmap_single(mmc_dev(host->mmc), host->align_addr,
 		128 * 4, direction);
 
+	/*
+	 * Premapped data is always aligned, so there is nothing to copy
+	 * back and post_req does the unmapping.
+	 */
+	if (data->host_cookie)
+		return;
+
 	if (data->flags & MMC_DATA_READ) {
 		dma_sync_sg_for_cpu(mmc_dev(host->mmc), data->sg,
 			data->sg_len, direction);
@@ -663,6 +677,7 @@ static void sdhci_prepare_data(struct sdhci_host *host, struct mmc_data *data)
 
 	host->data = data;
 	host->data_early = 0;
+	host->data_start = ktime_get();
 
 	count = sdhci_calc_timeout(host, data);
 	sdhci_writeb(host, count, SDHCI_TIMEOUT_CONTROL);
@@ -751,7 +766,11 @@ static void sdhci_prepare_data(struct sdhci_host *host, struct mmc_data *data)
 		} else {
 			int sg_cnt;
 
-			sg_cnt = dma_map_sg(mmc_dev(host->mmc),
+			/* Already mapped by sdhci_pre_req()? */
+			if (data->host_cookie)
+				sg_cnt = data->host_cookie;
+			else
+				sg_cnt = dma_map_sg(mmc_dev(host->mmc),
 					data->sg, data->sg_len,
 					(data->flags & MMC_DATA_READ) ?
 						DMA_FROM_DEVICE :
@@ -801,11 +820,25 @@ static void sdhci_prepare_data(struct sdhci_host *host, struct mmc_data *data)
 
 	sdhci_set_transfer_irqs(host);
 
-	/* We do not handle DMA boundaries, so set it to max (512 KiB) */
-	sdhci_writew(host, SDHCI_MAKE_BLKSZ(7, data->blksz), SDHCI_BLOCK_SIZE);
+	/*
+	 * Use the largest SDMA boundary, so a request takes at most one
+	 * DMA interrupt per 512 KiB (see sdhci_data_irq()).
+	 */
+	sdhci_writew(host, SDHCI_MAKE_BLKSZ(SDHCI_DEFAULT_BOUNDARY_ARG,
+		data->blksz), SDHCI_BLOCK_SIZE);
 	sdhci_writew(host, data->blocks, SDHCI_BLOCK_COUNT);
 }
 
+/*
+ * Let the controller send the stop command of open-ended multi-block
+ * transfers itself, saving a command and its interrupt per request.
+ */
+static bool sdhci_auto_cmd12(struct sdhci_host *host, struct mmc_data *data)
+{
+	return (host->quirks & SDHCI_QUIRK_MULTIBLOCK_AUTO_CMD12) &&
+		data->stop && data->blocks > 1;
+}
+
 static void sdhci_set_transfer_mode(struct sdhci_host *host,
 	struct mmc_data *data)
 {
@@ -819,6 +852,8 @@ static void sdhci_set_transfer_mode(struct sdhci_host *host,
 	mode = SDHCI_TRNS_BLK_CNT_EN;
 	if (data->blocks > 1)
 		mode |= SDHCI_TRNS_MULTI;
+	if (sdhci_auto_cmd12(host, data))
+		mode |= SDHCI_TRNS_ACMD12;
 	if (data->flags & MMC_DATA_READ)
 		mode |= SDHCI_TRNS_READ;
 	if (host->flags & SDHCI_REQ_USE_DMA)
@@ -839,7 +874,7 @@ static void sdhci_finish_data(struct sdhci_host *host)
 	if (host->flags & SDHCI_REQ_USE_DMA) {
 		if (host->flags & SDHCI_USE_ADMA)
 			sdhci_adma_table_post(host, data);
-		else {
+		else if (!data->host_cookie) {
 			dma_unmap_sg(mmc_dev(host->mmc), data->sg,
 				data->sg_len, (data->flags & MMC_DATA_READ) ?
 					DMA_FROM_DEVICE : DMA_TO_DEVICE);
@@ -858,7 +893,21 @@ static void sdhci_finish_data(struct sdhci_host *host)
 	else
 		data->bytes_xfered = data->blksz * data->blocks;
 
-	if (data->stop) {
+	host->stats.bytes += data->bytes_xfered;
+	host->stats.xfer_ns += ktime_to_ns(ktime_sub(ktime_get(),
+						     host->data_start));
+
+	/*
+	 * The controller has already stopped the transfer, unless the
+	 * transfer failed or the auto CMD12 did.  Its R1b response is
+	 * in the upper response word.
+	 */
+	if (!data->error && sdhci_auto_cmd12(host, data) &&
+	    !sdhci_readw(host, SDHCI_ACMD12_ERR)) {
+		data->stop->resp[0] = sdhci_readl(host, SDHCI_RESPONSE + 12);
+		host->stats.auto_cmd12++;
+		tasklet_schedule(&host->finish_tasklet);
+	} else if (data->stop) {
 		/*
 		 * The controller needs a reset of internal state machines
 		 * upon error conditions.
@@ -868,6 +917,7 @@ static void sdhci_finish_data(struct sdhci_host *host)
 			sdhci_reset(host, SDHCI_RESET_DATA);
 		}
 
+		host->stats.stop_cmds++;
 		sdhci_send_command(host, data->stop);
 	} else
 		tasklet_schedule(&host->finish_tasklet);
@@ -1110,6 +1160,7 @@ static void sdhci_request(struct mmc_host *mmc, struct mmc_request *mrq)
 #endif
 
 	host->mrq = mrq;
+	host->stats.requests++;
 
 	/* If polling, assume that the card is always present. */
 	if (host->quirks & SDHCI_QUIRK_BROKEN_CARD_DETECTION)
@@ -1184,6 +1235,73 @@ out:
 	spin_unlock_irqrestore(&host->lock, flags);
 }
 
+/*
+ * Map the data of a request for DMA while the previous request is
+ * still transferring, so that the cache maintenance is off the critical
+ * path.  Only done when sdhci_prepare_data() is sure to use DMA for it
+ * and, for ADMA, no entry needs the alignment bounce buffer; this is
+ * the common case for page cache I/O.  data->host_cookie then holds
+ * the mapped sg count.
+ */
+static void sdhci_pre_req(struct mmc_host *mmc, struct mmc_request *mrq,
+			  bool is_first_req)
+{
+	struct sdhci_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+	struct scatterlist *sg;
+	unsigned long flags;
+	int i;
+
+	if (!data)
+		return;
+
+	data->host_cookie = 0;
+
+	if (host->flags & SDHCI_USE_ADMA) {
+		for_each_sg(data->sg, sg, data->sg_len, i) {
+			if (sg->offset & 0x3)
+				return;
+			if ((host->quirks & SDHCI_QUIRK_32BIT_ADMA_SIZE) &&
+			    (sg->length & 0x3))
+				return;
+		}
+	} else if (host->flags & SDHCI_USE_SDMA) {
+		for_each_sg(data->sg, sg, data->sg_len, i) {
+			if ((host->quirks & SDHCI_QUIRK_32BIT_DMA_SIZE) &&
+			    (sg->length & 0x3))
+				return;
+			if ((host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) &&
+			    (sg->offset & 0x3))
+				return;
+		}
+	} else
+		return;
+
+	data->host_cookie = dma_map_sg(mmc_dev(mmc), data->sg, data->sg_len,
+				       (data->flags & MMC_DATA_READ) ?
+						DMA_FROM_DEVICE :
+						DMA_TO_DEVICE);
+	if (data->host_cookie) {
+		spin_lock_irqsave(&host->lock, flags);
+		host->stats.premapped++;
+		spin_unlock_irqrestore(&host->lock, flags);
+	}
+}
+
+static void sdhci_post_req(struct mmc_host *mmc, struct mmc_request *mrq,
+			   int err)
+{
+	struct mmc_data *data = mrq->data;
+
+	if (!data || !data->host_cookie)
+		return;
+
+	dma_unmap_sg(mmc_dev(mmc), data->sg, data->sg_len,
+		     (data->flags & MMC_DATA_READ) ?
+			DMA_FROM_DEVICE : DMA_TO_DEVICE);
+	data->host_cookie = 0;
+}
+
 static int sdhci_get_ro(struct mmc_host *mmc)
 {
 	struct sdhci_host *host;
@@ -1230,6 +1348,8 @@ out:
 
 static const struct mmc_host_ops sdhci_ops = {
 	.request	= sdhci_request,
+	.pre_req	= sdhci_pre_req,
+	.post_req	= sdhci_post_req,
 	.set_ios	= sdhci_set_ios,
 	.get_ro		= sdhci_get_ro,
 	.enable_sdio_irq = sdhci_enable_sdio_irq,
@@ -1481,13 +1601,22 @@ static void sdhci_data_irq(struct sdhci_host *host, u32 intmask)
 			sdhci_transfer_pio(host);
 
 		/*
-		 * We currently don't do anything fancy with DMA
-		 * boundaries, but as we can't disable the feature
-		 * we need to at least restart the transfer.
+		 * The SDMA engine stopped at a boundary.  Restart it at
+		 * the next boundary rather than at the address it reports,
+		 * which is not reliable on all controllers.  bytes_xfered
+		 * tracks the progress until sdhci_finish_data().
 		 */
-		if (intmask & SDHCI_INT_DMA_END)
-			sdhci_writel(host, sdhci_readl(host, SDHCI_DMA_ADDRESS),
-				SDHCI_DMA_ADDRESS);
+		if (intmask & SDHCI_INT_DMA_END) {
+			u32 dmastart, dmanow;
+
+			dmastart = sg_dma_address(host->data->sg);
+			dmanow = dmastart + host->data->bytes_xfered;
+			dmanow = (dmanow & ~(SDHCI_DEFAULT_BOUNDARY_SIZE - 1)) +
+				SDHCI_DEFAULT_BOUNDARY_SIZE;
+			host->data->bytes_xfered = dmanow - dmastart;
+			host->stats.dma_irqs++;
+			sdhci_writel(host, dmanow, SDHCI_DMA_ADDRESS);
+		}
 
 		if (intmask & SDHCI_INT_DATA_END) {
 			if (host->cmd) {
@@ -1523,6 +1652,8 @@ static irqreturn_t sdhci_irq(int irq, void *dev_id)
 	DBG("*** %s got interrupt: 0x%08x\n",
 		mmc_hostname(host->mmc), intmask);
 
+	host->stats.irqs++;
+
 	if (intmask & (SDHCI_INT_CARD_INSERT | SDHCI_INT_CARD_REMOVE)) {
 		sdhci_writel(host, intmask & (SDHCI_INT_CARD_INSERT |
 			SDHCI_INT_CARD_REMOVE), SDHCI_INT_STATUS);
@@ -1532,12 +1663,14 @@ static irqreturn_t sdhci_irq(int irq, void *dev_id)
 	intmask &= ~(SDHCI_INT_CARD_INSERT | SDHCI_INT_CARD_REMOVE);
 
 	if (intmask & SDHCI_INT_CMD_MASK) {
+		host->stats.cmd_irqs++;
 		sdhci_writel(host, intmask & SDHCI_INT_CMD_MASK,
 			SDHCI_INT_STATUS);
 		sdhci_cmd_irq(host, intmask & SDHCI_INT_CMD_MASK);
 	}
 
 	if (intmask & SDHCI_INT_DATA_MASK) {
+		host->stats.data_irqs++;
 		sdhci_writel(host, intmask & SDHCI_INT_DATA_MASK,
 			SDHCI_INT_STATUS);
 		sdhci_data_irq(host, intmask & SDHCI_INT_DATA_MASK);
@@ -1583,6 +1716,98 @@ out:
 	return result;
 }
 
+#ifdef CONFIG_DEBUG_FS
+
+/*****************************************************************************\
+ *                                                                           *
+ * Statistics                                                                *
+ *                                                                           *
+\*****************************************************************************/
+
+static int sdhci_stats_show(struct seq_file *s, void *unused)
+{
+	struct sdhci_host *host = s->private;
+	struct sdhci_stats st;
+	unsigned long flags;
+	u64 kbps, irqs_per_req;
+	u32 frac;
+
+	spin_lock_irqsave(&host->lock, flags);
+	st = host->stats;
+	spin_unlock_irqrestore(&host->lock, flags);
+
+	/* KiB per second of data transfer time: bytes * 10^9 / 2^10 / ns */
+	kbps = st.xfer_ns ? div64_u64(st.bytes * 976563, st.xfer_ns) : 0;
+
+	/* Whole and hundredths */
+	irqs_per_req = st.requests ?
+		div_u64((u64)st.irqs * 100, st.requests) : 0;
+	irqs_per_req = div_u64_rem(irqs_per_req, 100, &frac);
+
+	seq_printf(s, "mode:\t\t%s\n",
+		(host->flags & SDHCI_USE_ADMA) ? "ADMA" :
+		(host->flags & SDHCI_USE_SDMA) ? "DMA" : "PIO");
+	seq_printf(s, "requests:\t%lu\n", st.requests);
+	seq_printf(s, "irqs:\t\t%lu\n", st.irqs);
+	seq_printf(s, "cmd_irqs:\t%lu\n", st.cmd_irqs);
+	seq_printf(s, "data_irqs:\t%lu\n", st.data_irqs);
+	seq_printf(s, "dma_irqs:\t%lu\n", st.dma_irqs);
+	seq_printf(s, "irqs_per_req:\t%llu.%02u\n", irqs_per_req, frac);
+	seq_printf(s, "stop_cmds:\t%lu\n", st.stop_cmds);
+	seq_printf(s, "auto_cmd12:\t%lu\n", st.auto_cmd12);
+	seq_printf(s, "premapped:\t%lu\n", st.premapped);
+	seq_printf(s, "bytes:\t\t%llu\n", st.bytes);
+	seq_printf(s, "xfer_us:\t%llu\n", div_u64(st.xfer_ns, 1000));
+	seq_printf(s, "kbps:\t\t%llu\n", kbps);
+
+	return 0;
+}
+
+static int sdhci_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, sdhci_stats_show, inode->i_private);
+}
+
+static ssize_t sdhci_stats_write(struct file *file, const char __user *buf,
+	size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct sdhci_host *host = s->private;
+	unsigned long flags;
+
+	spin_lock_irqsave(&host->lock, flags);
+	memset(&host->stats, 0, sizeof(host->stats));
+	spin_unlock_irqrestore(&host->lock, flags);
+
+	return count;
+}
+
+static const struct file_operations sdhci_stats_fops = {
+	.open		= sdhci_stats_open,
+	.read		= seq_read,
+	.write		= sdhci_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void sdhci_add_debugfs(struct sdhci_host *host)
+{
+	struct dentry *root = host->mmc->debugfs_root;
+
+	/* Removed along with the host's directory */
+	if (root)
+		debugfs_create_file("sdhci_stats", S_IRUSR | S_IWUSR, root,
+			host, &sdhci_stats_fops);
+}
+
+#else
+
+static inline void sdhci_add_debugfs(struct sdhci_host *host)
+{
+}
+
+#endif /* CONFIG_DEBUG_FS */
+
 /*****************************************************************************\
  *                                                                           *
  * Suspend/resume                                                            *
@@ -1907,6 +2132,8 @@ int sdhci_add_host(struct sdhci_host *host)
 
 	mmc_add_host(mmc);
 
+	sdhci_add_debugfs(host);
+
 	printk(KERN_INFO "%s: SDHCI controller on %s [%s] using %s\n",
 		mmc_hostname(mmc), host->hw_name, dev_name(mmc_dev(mmc)),
 		(host->flags & SDHCI_USE_ADMA) ? "ADMA" :
@@ -15,6 +15,7 @@
 #include <linux/compiler.h>
 #include <linux/types.h>
 #include <linux/io.h>
+#include <linux/ktime.h>
 
 /*
  * Controller registers
@@ -25,6 +26,10 @@
 #define SDHCI_BLOCK_SIZE	0x04
 #define  SDHCI_MAKE_BLKSZ(dma, blksz) (((dma & 0x7) << 12) | (blksz & 0xFFF))
 
+/* SDMA stops and interrupts at every boundary; use the largest one */
+#define SDHCI_DEFAULT_BOUNDARY_SIZE	(512 * 1024)
+#define SDHCI_DEFAULT_BOUNDARY_ARG	7
+
 #define SDHCI_BLOCK_COUNT	0x06
 
 #define SDHCI_ARGUMENT		0x08
@@ -180,6 +185,23 @@
 
 struct sdhci_ops;
 
+/*
+ * Interrupt and transfer counters, shown in debugfs as
+ * mmcN/sdhci_stats.  Writing to the file clears them.
+ */
+struct sdhci_stats {
+	unsigned long		irqs;		/* interrupts handled */
+	unsigned long		cmd_irqs;	/* ... with command status */
+	unsigned long		data_irqs;	/* ... with data status */
+	unsigned long		dma_irqs;	/* SDMA boundary restarts */
+	unsigned long		requests;
+	unsigned long		stop_cmds;	/* CMD12 sent by the driver */
+	unsigned long		auto_cmd12;	/* CMD12 sent by the controller */
+	unsigned long		premapped;	/* data mapped by pre_req */
+	u64			bytes;		/* data transferred */
+	u64			xfer_ns;	/* time spent transferring data */
+};
+
 struct sdhci_host {
 	/* Data set by hardware interface driver */
 	const char		*hw_name;	/* Hardware bus name */
@@ -240,6 +262,8 @@ struct sdhci_host {
 #define SDHCI_QUIRK_CAP_CLOCK_BASE_BROKEN		(1<<25)
 /* Controller cannot support End Attribute in NOP ADMA descriptor */
 #define SDHCI_QUIRK_NO_ENDATTR_IN_NOPDESC		(1<<26)
+/* Controller reliably sends CMD12 itself after multi-block transfers */
+#define SDHCI_QUIRK_MULTIBLOCK_AUTO_CMD12		(1<<27)
 
 	int			irq;		/* Device IRQ */
 	void __iomem *		ioaddr;		/* Mapped address */
@@ -292,6 +316,9 @@ struct sdhci_host {
 
 	struct timer_list	timer;		/* Timer for timeouts */
 
+	ktime_t			data_start;	/* Current data started */
+	struct sdhci_stats	stats;		/* Updated under lock */
+
 	unsigned long		private[0] ____cacheline_aligned;
 };
 
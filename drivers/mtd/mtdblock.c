@@ -17,19 +17,64 @@
 #include <linux/mtd/mtd.h>
 #include <linux/mtd/blktrans.h>
 #include <linux/mutex.h>
+#include <linux/timer.h>
+#include <linux/workqueue.h>
+#include <linux/genhd.h>
 
+/* Upper limit of the per device cache, each entry is one erase block */
+#define MTDBLOCK_MAX_CACHE_ENTRIES	16
+
+static unsigned int cache_entries = 4;
+module_param(cache_entries, uint, S_IRUGO);
+MODULE_PARM_DESC(cache_entries,
+	"Number of erase blocks cached per device (4 default)");
+
+/* Bounds of the write-back timeout, in ms */
+#define MTDBLOCK_MIN_CACHE_TIMEOUT	10
+#define MTDBLOCK_MAX_CACHE_TIMEOUT	60000
+
+static unsigned int cache_timeout = 1000;
+
+static int cache_timeout_set(const char *val, struct kernel_param *kp)
+{
+	unsigned long timeout;
+
+	if (strict_strtoul(val, 0, &timeout))
+		return -EINVAL;
+	if (timeout < MTDBLOCK_MIN_CACHE_TIMEOUT ||
+	    timeout > MTDBLOCK_MAX_CACHE_TIMEOUT)
+		return -EINVAL;
+
+	*(unsigned int *)kp->arg = timeout;
+	return 0;
+}
+module_param_call(cache_timeout, cache_timeout_set, param_get_uint,
+		  &cache_timeout, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(cache_timeout,
+	"Timeout (in ms) for background write-back of the cache, "
+	"10 to 60000 (1000 ms default)");
+
+struct mtdblk_cache {
+	struct list_head list;
+	unsigned char *data;
+	unsigned long offset;
+	enum { STATE_EMPTY, STATE_CLEAN, STATE_DIRTY } state;
+};
 
 struct mtdblk_dev {
 	struct mtd_blktrans_dev mbd;
 	int count;
 	struct mutex cache_mutex;
-	unsigned char *cache_data;
-	unsigned long cache_offset;
+	struct mtdblk_cache *cache;
+	struct list_head cache_lru;	/* most recently used first */
+	unsigned int cache_entries;
 	unsigned int cache_size;
-	enum { STATE_EMPTY, STATE_CLEAN, STATE_DIRTY } cache_state;
+	struct timer_list timer;
+	struct work_struct flush_work;
 };
 
 static struct mutex mtdblks_lock;
+static struct workqueue_struct *mtdblock_wq;
 
 /*
  * Cache stuff...
@@ -37,8 +82,10 @@ static struct mutex mtdblks_lock;
  * Since typical flash erasable sectors are much larger than what Linux's
  * buffer cache can handle, we must implement read-modify-write on flash
  * sectors for each block write requests.  To avoid over-erasing flash sectors
- * and to speed things up, we locally cache a whole flash sector while it is
- * being written to until a different sector is required.
+ * and to speed things up, we locally cache a few whole flash sectors while
+ * they are being written to.  When another sector is required the least
+ * recently used one is written back; dirty sectors are also written back
+ * in the background cache_timeout ms after they were first modified.
  */
 
 static void erase_callback(struct erase_info *done)
@@ -96,20 +143,20 @@ static int erase_write (struct mtd_info *mtd, unsigned long pos,
 }
 
 
-static int write_cached_data (struct mtdblk_dev *mtdblk)
+static int write_cached_entry(struct mtdblk_dev *mtdblk,
+			      struct mtdblk_cache *c)
 {
 	struct mtd_info *mtd = mtdblk->mbd.mtd;
 	int ret;
 
-	if (mtdblk->cache_state != STATE_DIRTY)
+	if (c->state != STATE_DIRTY)
 		return 0;
 
 	DEBUG(MTD_DEBUG_LEVEL2, "mtdblock: writing cached data for \"%s\" "
 			"at 0x%lx, size 0x%x\n", mtd->name,
-			mtdblk->cache_offset, mtdblk->cache_size);
+			c->offset, mtdblk->cache_size);
 
-	ret = erase_write (mtd, mtdblk->cache_offset,
-			   mtdblk->cache_size, mtdblk->cache_data);
+	ret = erase_write (mtd, c->offset, mtdblk->cache_size, c->data);
 	if (ret)
 		return ret;
 
@@ -120,16 +167,107 @@ static int write_cached_data (struct mtdblk_dev *mtdblk)
 	 * means.  Let's declare it empty and leave buffering tasks to
 	 * the buffer cache instead.
 	 */
-	mtdblk->cache_state = STATE_EMPTY;
+	c->state = STATE_EMPTY;
 	return 0;
 }
 
+static int write_cached_data (struct mtdblk_dev *mtdblk)
+{
+	struct mtdblk_cache *c;
+	int ret = 0, err;
+
+	if (!mtdblk->cache)
+		return 0;
+
+	list_for_each_entry(c, &mtdblk->cache_lru, list) {
+		err = write_cached_entry(mtdblk, c);
+		if (err && !ret)
+			ret = err;
+	}
+
+	return ret;
+}
+
+static struct mtdblk_cache *find_cached_sect(struct mtdblk_dev *mtdblk,
+					     unsigned long sect_start)
+{
+	struct mtdblk_cache *c;
+
+	if (!mtdblk->cache)
+		return NULL;
+
+	list_for_each_entry(c, &mtdblk->cache_lru, list) {
+		if (c->state != STATE_EMPTY && c->offset == sect_start) {
+			list_move(&c->list, &mtdblk->cache_lru);
+			return c;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Get a cache entry holding the given sector, reading it from flash into
+ * an empty or the least recently used entry if it is not cached yet.
+ */
+static struct mtdblk_cache *get_cached_sect(struct mtdblk_dev *mtdblk,
+					    unsigned long sect_start)
+{
+	struct mtd_info *mtd = mtdblk->mbd.mtd;
+	unsigned int sect_size = mtdblk->cache_size;
+	struct mtdblk_cache *c, *victim = NULL;
+	size_t retlen;
+	int ret;
+
+	c = find_cached_sect(mtdblk, sect_start);
+	if (c)
+		return c;
+
+	list_for_each_entry(c, &mtdblk->cache_lru, list) {
+		if (c->state == STATE_EMPTY) {
+			victim = c;
+			break;
+		}
+	}
+	if (!victim) {
+		victim = list_entry(mtdblk->cache_lru.prev,
+				    struct mtdblk_cache, list);
+		ret = write_cached_entry(mtdblk, victim);
+		if (ret)
+			return ERR_PTR(ret);
+	}
+
+	if (unlikely(!victim->data)) {
+		victim->data = vmalloc(sect_size);
+		if (!victim->data)
+			return ERR_PTR(-EINTR);
+		/* -EINTR is not really correct, but it is the best match
+		 * documented in man 2 write for all cases.  We could also
+		 * return -EAGAIN sometimes, but why bother?
+		 */
+	}
+
+	/* fill the cache with the current sector */
+	victim->state = STATE_EMPTY;
+	ret = mtd->read(mtd, sect_start, sect_size, &retlen, victim->data);
+	if (ret)
+		return ERR_PTR(ret);
+	if (retlen != sect_size)
+		return ERR_PTR(-EIO);
+
+	victim->offset = sect_start;
+	victim->state = STATE_CLEAN;
+	list_move(&victim->list, &mtdblk->cache_lru);
+
+	return victim;
+}
 
 static int do_cached_write (struct mtdblk_dev *mtdblk, unsigned long pos,
 			    int len, const char *buf)
 {
 	struct mtd_info *mtd = mtdblk->mbd.mtd;
 	unsigned int sect_size = mtdblk->cache_size;
+	struct mtdblk_cache *c;
 	size_t retlen;
 	int ret;
 
@@ -150,40 +288,29 @@ static int do_cached_write (struct mtdblk_dev *mtdblk, unsigned long pos,
 			/*
 			 * We are covering a whole sector.  Thus there is no
 			 * need to bother with the cache while it may still be
-			 * useful for other partial writes.
+			 * useful for other partial writes.  A cached copy of
+			 * this sector is stale now.
 			 */
+			c = find_cached_sect(mtdblk, sect_start);
+			if (c)
+				c->state = STATE_EMPTY;
+
 			ret = erase_write (mtd, pos, size, buf);
 			if (ret)
 				return ret;
 		} else {
 			/* Partial sector: need to use the cache */
-
-			if (mtdblk->cache_state == STATE_DIRTY &&
-			    mtdblk->cache_offset != sect_start) {
-				ret = write_cached_data(mtdblk);
-				if (ret)
-					return ret;
-			}
-
-			if (mtdblk->cache_state == STATE_EMPTY ||
-			    mtdblk->cache_offset != sect_start) {
-				/* fill the cache with the current sector */
-				mtdblk->cache_state = STATE_EMPTY;
-				ret = mtd->read(mtd, sect_start, sect_size,
-						&retlen, mtdblk->cache_data);
-				if (ret)
-					return ret;
-				if (retlen != sect_size)
-					return -EIO;
-
-				mtdblk->cache_offset = sect_start;
-				mtdblk->cache_size = sect_size;
-				mtdblk->cache_state = STATE_CLEAN;
-			}
+			c = get_cached_sect(mtdblk, sect_start);
+			if (IS_ERR(c))
+				return PTR_ERR(c);
 
 			/* write data to our local cache */
-			memcpy (mtdblk->cache_data + offset, buf, size);
-			mtdblk->cache_state = STATE_DIRTY;
+			memcpy (c->data + offset, buf, size);
+			c->state = STATE_DIRTY;
+
+			if (!timer_pending(&mtdblk->timer))
+				mod_timer(&mtdblk->timer, jiffies +
+					  msecs_to_jiffies(cache_timeout));
 		}
 
 		buf += size;
@@ -200,6 +327,7 @@ static int do_cached_read (struct mtdblk_dev *mtdblk, unsigned long pos,
 {
 	struct mtd_info *mtd = mtdblk->mbd.mtd;
 	unsigned int sect_size = mtdblk->cache_size;
+	struct mtdblk_cache *c;
 	size_t retlen;
 	int ret;
 
@@ -222,9 +350,9 @@ static int do_cached_read (struct mtdblk_dev *mtdblk, unsigned long pos,
 		 * contains what we want, otherwise we read the data directly
 		 * from flash.
 		 */
-		if (mtdblk->cache_state != STATE_EMPTY &&
-		    mtdblk->cache_offset == sect_start) {
-			memcpy (buf, mtdblk->cache_data + offset, size);
+		c = find_cached_sect(mtdblk, sect_start);
+		if (c) {
+			memcpy (buf, c->data + offset, size);
 		} else {
 			ret = mtd->read(mtd, pos, size, &retlen, buf);
 			if (ret)
@@ -241,32 +369,91 @@ static int do_cached_read (struct mtdblk_dev *mtdblk, unsigned long pos,
 	return 0;
 }
 
+/* flush timer, runs cache_timeout ms after the cache got dirty */
+static void mtdblock_flush_timer(unsigned long data)
+{
+	struct mtdblk_dev *mtdblk = (struct mtdblk_dev *)data;
+
+	queue_work(mtdblock_wq, &mtdblk->flush_work);
+}
+
+/* cache flush work, kicked by timer */
+static void mtdblock_flush_work(struct work_struct *work)
+{
+	struct mtdblk_dev *mtdblk =
+		container_of(work, struct mtdblk_dev, flush_work);
+
+	mutex_lock(&mtdblk->cache_mutex);
+	write_cached_data(mtdblk);
+	mutex_unlock(&mtdblk->cache_mutex);
+}
+
+static int alloc_cache(struct mtdblk_dev *mtdblk)
+{
+	unsigned int i;
+
+	INIT_LIST_HEAD(&mtdblk->cache_lru);
+	if (!mtdblk->cache_size)
+		return 0;
+
+	mtdblk->cache = kcalloc(mtdblk->cache_entries,
+				sizeof(struct mtdblk_cache), GFP_KERNEL);
+	if (!mtdblk->cache)
+		return -ENOMEM;
+
+	/* Buffers are only allocated on first write */
+	for (i = 0; i < mtdblk->cache_entries; i++) {
+		mtdblk->cache[i].state = STATE_EMPTY;
+		list_add_tail(&mtdblk->cache[i].list, &mtdblk->cache_lru);
+	}
+
+	return 0;
+}
+
+static void free_cache(struct mtdblk_dev *mtdblk)
+{
+	unsigned int i;
+
+	if (!mtdblk->cache)
+		return;
+
+	for (i = 0; i < mtdblk->cache_entries; i++)
+		vfree(mtdblk->cache[i].data);
+	kfree(mtdblk->cache);
+	mtdblk->cache = NULL;
+	INIT_LIST_HEAD(&mtdblk->cache_lru);
+}
+
 static int mtdblock_readsect(struct mtd_blktrans_dev *dev,
 			      unsigned long block, char *buf)
 {
 	struct mtdblk_dev *mtdblk = container_of(dev, struct mtdblk_dev, mbd);
-	return do_cached_read(mtdblk, block<<9, 512, buf);
+	int ret;
+
+	mutex_lock(&mtdblk->cache_mutex);
+	ret = do_cached_read(mtdblk, block<<9, 512, buf);
+	mutex_unlock(&mtdblk->cache_mutex);
+
+	return ret;
 }
 
 static int mtdblock_writesect(struct mtd_blktrans_dev *dev,
 			      unsigned long block, char *buf)
 {
 	struct mtdblk_dev *mtdblk = container_of(dev, struct mtdblk_dev, mbd);
-	if (unlikely(!mtdblk->cache_data && mtdblk->cache_size)) {
-		mtdblk->cache_data = vmalloc(mtdblk->mbd.mtd->erasesize);
-		if (!mtdblk->cache_data)
-			return -EINTR;
-		/* -EINTR is not really correct, but it is the best match
-		 * documented in man 2 write for all cases.  We could also
-		 * return -EAGAIN sometimes, but why bother?
-		 */
-	}
-	return do_cached_write(mtdblk, block<<9, 512, buf);
+	int ret;
+
+	mutex_lock(&mtdblk->cache_mutex);
+	ret = do_cached_write(mtdblk, block<<9, 512, buf);
+	mutex_unlock(&mtdblk->cache_mutex);
+
+	return ret;
 }
 
 static int mtdblock_open(struct mtd_blktrans_dev *mbd)
 {
 	struct mtdblk_dev *mtdblk = container_of(mbd, struct mtdblk_dev, mbd);
+	int ret;
 
 	DEBUG(MTD_DEBUG_LEVEL1,"mtdblock_open\n");
 
@@ -278,19 +465,19 @@ static int mtdblock_open(struct mtd_blktrans_dev *mbd)
 	}
 
 	/* OK, it's not open. Create cache info for it */
-	mtdblk->count = 1;
-	mutex_init(&mtdblk->cache_mutex);
-	mtdblk->cache_state = STATE_EMPTY;
-	if (!(mbd->mtd->flags & MTD_NO_ERASE) && mbd->mtd->erasesize) {
+	mtdblk->cache_size = 0;
+	if (!(mbd->mtd->flags & MTD_NO_ERASE) && mbd->mtd->erasesize)
 		mtdblk->cache_size = mbd->mtd->erasesize;
-		mtdblk->cache_data = NULL;
-	}
+
+	ret = alloc_cache(mtdblk);
+	if (!ret)
+		mtdblk->count = 1;
 
 	mutex_unlock(&mtdblks_lock);
 
 	DEBUG(MTD_DEBUG_LEVEL1, "ok\n");
 
-	return 0;
+	return ret;
 }
 
 static int mtdblock_release(struct mtd_blktrans_dev *mbd)
@@ -307,9 +494,11 @@ static int mtdblock_release(struct mtd_blktrans_dev *mbd)
 
 	if (!--mtdblk->count) {
 		/* It was the last usage. Free the cache */
+		del_timer_sync(&mtdblk->timer);
+		cancel_work_sync(&mtdblk->flush_work);
 		if (mbd->mtd->sync)
 			mbd->mtd->sync(mbd->mtd);
-		vfree(mtdblk->cache_data);
+		free_cache(mtdblk);
 	}
 
 	mutex_unlock(&mtdblks_lock);
@@ -332,6 +521,63 @@ static int mtdblock_flush(struct mtd_blktrans_dev *dev)
 	return 0;
 }
 
+/* ------------------- sysfs attributes ---------------------------------- */
+
+static ssize_t mtdblock_cache_entries_show(struct device *dev,
+					   struct device_attribute *attr,
+					   char *buf)
+{
+	struct mtd_blktrans_dev *mbd = dev_to_disk(dev)->private_data;
+	struct mtdblk_dev *mtdblk = container_of(mbd, struct mtdblk_dev, mbd);
+
+	return sprintf(buf, "%u\n", mtdblk->cache_entries);
+}
+
+/* Resizing an open device writes the whole cache back first */
+static ssize_t mtdblock_cache_entries_store(struct device *dev,
+					    struct device_attribute *attr,
+					    const char *buf, size_t count)
+{
+	struct mtd_blktrans_dev *mbd = dev_to_disk(dev)->private_data;
+	struct mtdblk_dev *mtdblk = container_of(mbd, struct mtdblk_dev, mbd);
+	unsigned long val;
+	int ret = 0;
+
+	if (strict_strtoul(buf, 0, &val) ||
+	    val < 1 || val > MTDBLOCK_MAX_CACHE_ENTRIES)
+		return -EINVAL;
+
+	mutex_lock(&mtdblks_lock);
+	mutex_lock(&mtdblk->cache_mutex);
+
+	if (mtdblk->count && mtdblk->cache) {
+		ret = write_cached_data(mtdblk);
+		if (!ret) {
+			free_cache(mtdblk);
+			mtdblk->cache_entries = val;
+			ret = alloc_cache(mtdblk);
+		}
+	} else
+		mtdblk->cache_entries = val;
+
+	mutex_unlock(&mtdblk->cache_mutex);
+	mutex_unlock(&mtdblks_lock);
+
+	return ret ? ret : count;
+}
+
+static DEVICE_ATTR(cache_entries, S_IRUGO | S_IWUSR,
+		   mtdblock_cache_entries_show, mtdblock_cache_entries_store);
+
+static struct attribute *mtdblock_attrs[] = {
+	&dev_attr_cache_entries.attr,
+	NULL,
+};
+
+static struct attribute_group mtdblock_attr_group = {
+	.attrs = mtdblock_attrs,
+};
+
 static void mtdblock_add_mtd(struct mtd_blktrans_ops *tr, struct mtd_info *mtd)
 {
 	struct mtdblk_dev *dev = kzalloc(sizeof(*dev), GFP_KERNEL);
@@ -347,6 +593,15 @@ static void mtdblock_add_mtd(struct mtd_blktrans_ops *tr, struct mtd_info *mtd)
 
 	if (!(mtd->flags & MTD_WRITEABLE))
 		dev->mbd.readonly = 1;
+	else
+		dev->mbd.disk_attributes = &mtdblock_attr_group;
+
+	mutex_init(&dev->cache_mutex);
+	INIT_LIST_HEAD(&dev->cache_lru);
+	dev->cache_entries = clamp_t(unsigned int, cache_entries, 1,
+				     MTDBLOCK_MAX_CACHE_ENTRIES);
+	setup_timer(&dev->timer, mtdblock_flush_timer, (unsigned long)dev);
+	INIT_WORK(&dev->flush_work, mtdblock_flush_work);
 
 	if (add_mtd_blktrans_dev(&dev->mbd))
 		kfree(dev);
@@ -374,14 +629,24 @@ static struct mtd_blktrans_ops mtdblock_tr = {
 
 static int __init init_mtdblock(void)
 {
+	int ret;
+
 	mutex_init(&mtdblks_lock);
 
-	return register_mtd_blktrans(&mtdblock_tr);
+	mtdblock_wq = create_freezeable_workqueue("mtdblockd");
+	if (!mtdblock_wq)
+		return -ENOMEM;
+
+	ret = register_mtd_blktrans(&mtdblock_tr);
+	if (ret)
+		destroy_workqueue(mtdblock_wq);
+	return ret;
 }
 
 static void __exit cleanup_mtdblock(void)
 {
 	deregister_mtd_blktrans(&mtdblock_tr);
+	destroy_workqueue(mtdblock_wq);
 }
 
 module_init(init_mtdblock);
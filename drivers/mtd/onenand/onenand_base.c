@@ -1071,7 +1071,8 @@ static int onenand_recover_lsb(struct mtd_info *mtd, loff_t addr, int status)
  * @param ops:		oob operation description structure
  *
  * MLC OneNAND / Flex-OneNAND has 4KB page size and 4KB dataram.
- * So, read-while-load is not present.
+ * So, read-while-load is not present. 4KB page OneNAND uses this too,
+ * unless the controller provides two 4KB BufferRAMs.
  */
 static int onenand_mlc_read_ops_nolock(struct mtd_info *mtd, loff_t from,
 				struct mtd_oob_ops *ops)
@@ -1426,9 +1427,9 @@ static int onenand_read(struct mtd_info *mtd, loff_t from, size_t len,
 	int ret;
 
 	onenand_get_device(mtd, FL_READING);
-	ret = ONENAND_IS_MLC(this) || ONENAND_IS_4KB_PAGE(this) ?
-		onenand_mlc_read_ops_nolock(mtd, from, &ops) :
-		onenand_read_ops_nolock(mtd, from, &ops);
+	ret = ONENAND_IS_READ_WHILE_LOAD(this) ?
+		onenand_read_ops_nolock(mtd, from, &ops) :
+		onenand_mlc_read_ops_nolock(mtd, from, &ops);
 	onenand_release_device(mtd);
 
 	*retlen = ops.retlen;
@@ -1461,9 +1462,9 @@ static int onenand_read_oob(struct mtd_info *mtd, loff_t from,
 
 	onenand_get_device(mtd, FL_READING);
 	if (ops->datbuf)
-		ret = ONENAND_IS_MLC(this) || ONENAND_IS_4KB_PAGE(this) ?
-			onenand_mlc_read_ops_nolock(mtd, from, ops) :
-			onenand_read_ops_nolock(mtd, from, ops);
+		ret = ONENAND_IS_READ_WHILE_LOAD(this) ?
+			onenand_read_ops_nolock(mtd, from, ops) :
+			onenand_mlc_read_ops_nolock(mtd, from, ops);
 	else
 		ret = onenand_read_oob_nolock(mtd, from, ops);
 	onenand_release_device(mtd);
@@ -3026,9 +3027,9 @@ static int do_otp_read(struct mtd_info *mtd, loff_t from, size_t len,
 	this->command(mtd, ONENAND_CMD_OTP_ACCESS, 0, 0);
 	this->wait(mtd, FL_OTPING);
 
-	ret = ONENAND_IS_MLC(this) || ONENAND_IS_4KB_PAGE(this) ?
-		onenand_mlc_read_ops_nolock(mtd, from, &ops) :
-		onenand_read_ops_nolock(mtd, from, &ops);
+	ret = ONENAND_IS_READ_WHILE_LOAD(this) ?
+		onenand_read_ops_nolock(mtd, from, &ops) :
+		onenand_mlc_read_ops_nolock(mtd, from, &ops);
 
 	/* Exit OTP access mode */
 	this->command(mtd, ONENAND_CMD_RESET, 0, 0);
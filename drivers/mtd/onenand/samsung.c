@@ -11,6 +11,7 @@
  *
  * Implementation:
  *	S3C64XX and S5PC100: emulate the pseudo BufferRAM
+ *	S3C64XX: fill the pseudo BufferRAM by PL080 DMA if available
  *	S5PC110: use DMA
  */
 
@@ -25,6 +26,9 @@
 
 #include <asm/mach/flash.h>
 #include <plat/regs-onenand.h>
+#ifdef CONFIG_S3C64XX_DMA
+#include <mach/dma.h>
+#endif
 
 #include <linux/io.h>
 
@@ -72,6 +76,9 @@ enum soc_type {
 #define S5PC100_FPA_SHIFT		7
 #define S5PC100_FSA_SHIFT		5
 
+/* S3C64XX: main area transfers shorter than this are left to the CPU */
+#define S3C64XX_DMA_MIN_SIZE		512
+
 /* S5PC110 specific definitions */
 #define S5PC110_DMA_SRC_ADDR		0x400
 #define S5PC110_DMA_SRC_CFG		0x404
@@ -134,6 +141,16 @@ struct s3c_onenand {
 	void __iomem	*dma_addr;
 	struct resource *dma_res;
 	unsigned long	phys_base;
+	int		use_dma;
+	int		dma_busy;
+	int		dma_err;
+#ifdef CONFIG_S3C64XX_DMA
+	unsigned long	ahb_phys;
+	dma_addr_t	dma_dst;
+	int		dma_len;
+	struct completion dma_done;
+	enum s3c2410_dma_buffresult dma_result;
+#endif
 #ifdef CONFIG_MTD_PARTITIONS
 	struct mtd_partition *parts;
 #endif
@@ -326,6 +343,137 @@ static void s3c_onenand_writew(unsigned short value, void __iomem *addr)
 	s3c_write_cmd(value, CMD_MAP_11(onenand, word_addr));
 }
 
+#ifdef CONFIG_S3C64XX_DMA
+static struct s3c2410_dma_client s3c64xx_onenand_dma_client = {
+	.name		= "samsung-onenand",
+};
+
+static void s3c64xx_onenand_dma_done(struct s3c2410_dma_chan *chan,
+				     void *buf_id, int size,
+				     enum s3c2410_dma_buffresult result)
+{
+	onenand->dma_result = result;
+	complete(&onenand->dma_done);
+}
+
+/*
+ * Start reading @count bytes from the fixed data port at @cmd into @buf
+ * with the PL080. Returns -EAGAIN if the transfer could not be started,
+ * so the caller can still use the CPU. The transfer is completed by
+ * s3c64xx_onenand_dma_finish().
+ */
+static int s3c64xx_onenand_dma_start(void *buf, unsigned int cmd, int count)
+{
+	struct device *dev = &onenand->pdev->dev;
+	dma_addr_t dma_dst;
+
+	dma_dst = dma_map_single(dev, buf, count, DMA_FROM_DEVICE);
+	if (dma_mapping_error(dev, dma_dst))
+		return -EAGAIN;
+
+	INIT_COMPLETION(onenand->dma_done);
+
+	s3c2410_dma_devconfig(DMACH_ONENAND_IN, S3C2410_DMASRC_MEM2MEM,
+			      onenand->ahb_phys + cmd);
+	if (s3c2410_dma_enqueue(DMACH_ONENAND_IN, NULL, dma_dst, count)) {
+		dma_unmap_single(dev, dma_dst, count, DMA_FROM_DEVICE);
+		return -EAGAIN;
+	}
+
+	onenand->dma_dst = dma_dst;
+	onenand->dma_len = count;
+	onenand->dma_busy = 1;
+
+	s3c2410_dma_ctrl(DMACH_ONENAND_IN, S3C2410_DMAOP_START);
+
+	return 0;
+}
+
+/*
+ * Wait for the transfer started by s3c64xx_onenand_dma_start(), if any,
+ * and record its result for the following wait.
+ */
+static void s3c64xx_onenand_dma_finish(void)
+{
+	struct device *dev = &onenand->pdev->dev;
+	int err = 0;
+
+	if (!onenand->dma_busy)
+		return;
+
+	/* The 20 msec is enough, as in s3c_onenand_wait() */
+	if (!wait_for_completion_timeout(&onenand->dma_done,
+					 msecs_to_jiffies(20))) {
+		s3c2410_dma_ctrl(DMACH_ONENAND_IN, S3C2410_DMAOP_FLUSH);
+		err = -ETIMEDOUT;
+	} else if (onenand->dma_result != S3C2410_RES_OK)
+		err = -EIO;
+
+	dma_unmap_single(dev, onenand->dma_dst, onenand->dma_len,
+			 DMA_FROM_DEVICE);
+	onenand->dma_busy = 0;
+	if (err)
+		onenand->dma_err = err;
+}
+
+static void s3c64xx_onenand_dma_init(struct platform_device *pdev)
+{
+	if (onenand->type != TYPE_S3C6400 && onenand->type != TYPE_S3C6410)
+		return;
+
+	onenand->ahb_phys = onenand->ahb_res->start;
+	init_completion(&onenand->dma_done);
+
+	if (s3c2410_dma_request(DMACH_ONENAND_IN,
+				&s3c64xx_onenand_dma_client, NULL) < 0) {
+		dev_info(&pdev->dev, "no DMA channel, using CPU transfers\n");
+		return;
+	}
+
+	s3c2410_dma_config(DMACH_ONENAND_IN, 4);
+	s3c2410_dma_set_buffdone_fn(DMACH_ONENAND_IN,
+				    s3c64xx_onenand_dma_done);
+	onenand->use_dma = 1;
+}
+
+static void s3c64xx_onenand_dma_release(void)
+{
+	if (!onenand->use_dma)
+		return;
+
+	s3c2410_dma_free(DMACH_ONENAND_IN, &s3c64xx_onenand_dma_client);
+	onenand->use_dma = 0;
+}
+#else
+static inline int s3c64xx_onenand_dma_start(void *buf, unsigned int cmd,
+					    int count)
+{
+	return -EAGAIN;
+}
+
+static inline void s3c64xx_onenand_dma_finish(void) { }
+static inline void s3c64xx_onenand_dma_init(struct platform_device *pdev) { }
+static inline void s3c64xx_onenand_dma_release(void) { }
+#endif
+
+/*
+ * Fill the main area of the current pseudo BufferRAM. With DMA this only
+ * starts the load, so the caller can copy out the other BufferRAM while
+ * it runs (read-while-load); s3c_onenand_wait() completes it.
+ */
+static void s3c_onenand_read_main(unsigned int *m, unsigned int cmd_map_01,
+				  int mcount)
+{
+	int i;
+
+	if (onenand->use_dma && (mcount << 2) >= S3C64XX_DMA_MIN_SIZE &&
+	    !s3c64xx_onenand_dma_start(m, cmd_map_01, mcount << 2))
+		return;
+
+	for (i = 0; i < mcount; i++)
+		*m++ = s3c_read_cmd(cmd_map_01);
+}
+
 static int s3c_onenand_wait(struct mtd_info *mtd, int state)
 {
 	struct device *dev = &onenand->pdev->dev;
@@ -333,6 +481,8 @@ static int s3c_onenand_wait(struct mtd_info *mtd, int state)
 	unsigned int stat, ecc;
 	unsigned long timeout;
 
+	s3c64xx_onenand_dma_finish();
+
 	switch (state) {
 	case FL_READING:
 		flags |= BLK_RW_CMP | LOAD_CMP;
@@ -364,6 +514,14 @@ static int s3c_onenand_wait(struct mtd_info *mtd, int state)
 	stat = s3c_read_reg(INT_ERR_STAT_OFFSET);
 	s3c_write_reg(stat, INT_ERR_ACK_OFFSET);
 
+	/* The pseudo BufferRAM load by DMA failed */
+	if (state == FL_READING && onenand->dma_err) {
+		dev_info(dev, "%s: DMA error = %d\n", __func__,
+			 onenand->dma_err);
+		onenand->dma_err = 0;
+		return -EIO;
+	}
+
 	/*
 	 * In the Spec. it checks the controller status first
 	 * However if you get the correct information in case of
@@ -402,6 +560,9 @@ static int s3c_onenand_command(struct mtd_info *mtd, int cmd, loff_t addr,
 	int i, mcount, scount;
 	int index;
 
+	/* Complete a pending BufferRAM load before using the port again */
+	s3c64xx_onenand_dma_finish();
+
 	fba = (int) (addr >> this->erase_shift);
 	fpa = (int) (addr >> this->page_shift);
 	fpa &= this->page_mask;
@@ -438,15 +599,15 @@ static int s3c_onenand_command(struct mtd_info *mtd, int cmd, loff_t addr,
 	switch (cmd) {
 	case ONENAND_CMD_READ:
 		/* Main */
-		for (i = 0; i < mcount; i++)
-			*m++ = s3c_read_cmd(cmd_map_01);
+		s3c_onenand_read_main(m, cmd_map_01, mcount);
 		return 0;
 
 	case ONENAND_CMD_READOOB:
 		s3c_write_reg(TSRF, TRANS_SPARE_OFFSET);
 		/* Main */
-		for (i = 0; i < mcount; i++)
-			*m++ = s3c_read_cmd(cmd_map_01);
+		s3c_onenand_read_main(m, cmd_map_01, mcount);
+		/* The spare area follows on the same port */
+		s3c64xx_onenand_dma_finish();
 
 		/* Spare */
 		for (i = 0; i < scount; i++)
@@ -636,6 +797,8 @@ static int s3c_onenand_bbt_wait(struct mtd_info *mtd, int state)
 	unsigned int stat;
 	unsigned long timeout;
 
+	s3c64xx_onenand_dma_finish();
+
 	/* The 20 msec is enough */
 	timeout = jiffies + msecs_to_jiffies(20);
 	while (time_before(jiffies, timeout)) {
@@ -652,6 +815,11 @@ static int s3c_onenand_bbt_wait(struct mtd_info *mtd, int state)
 		return ONENAND_BBT_READ_ERROR;
 	}
 
+	if (onenand->dma_err) {
+		onenand->dma_err = 0;
+		return ONENAND_BBT_READ_ERROR;
+	}
+
 	if (stat & LOAD_CMP) {
 		int ecc = s3c_read_reg(ECC_ERR_STAT_OFFSET);
 		if (ecc & ONENAND_ECC_4BIT_UNCORRECTABLE) {
@@ -858,20 +1026,26 @@ static int s3c_onenand_probe(struct platform_device *pdev)
 			goto ahb_ioremap_failed;
 		}
 
-		/* Allocate 4KiB BufferRAM */
-		onenand->page_buf = kzalloc(SZ_4K, GFP_KERNEL);
+		/* Allocate two 4KiB BufferRAMs */
+		onenand->page_buf = kzalloc(SZ_4K << 1, GFP_KERNEL);
 		if (!onenand->page_buf) {
 			err = -ENOMEM;
 			goto page_buf_fail;
 		}
 
-		/* Allocate 128 SpareRAM */
-		onenand->oob_buf = kzalloc(128, GFP_KERNEL);
+		/* Allocate two 128 SpareRAMs */
+		onenand->oob_buf = kzalloc(128 << 1, GFP_KERNEL);
 		if (!onenand->oob_buf) {
 			err = -ENOMEM;
 			goto oob_buf_fail;
 		}
 
+		s3c64xx_onenand_dma_init(pdev);
+
+		/* Read-while-load on 4KiB page chips too */
+		if (onenand->use_dma)
+			this->options |= ONENAND_HAS_2X_BUFFERRAM;
+
 		/* S3C doesn't handle subpage write */
 		mtd->subpage_sft = 0;
 		this->subpagesize = mtd->writesize;
@@ -942,6 +1116,7 @@ static int s3c_onenand_probe(struct platform_device *pdev)
 	return 0;
 
 scan_failed:
+	s3c64xx_onenand_dma_release();
 	if (onenand->dma_addr)
 		iounmap(onenand->dma_addr);
 dma_ioremap_failed:
@@ -977,6 +1152,7 @@ static int __devexit s3c_onenand_remove(struct platform_device *pdev)
 	struct mtd_info *mtd = platform_get_drvdata(pdev);
 
 	onenand_release(mtd);
+	s3c64xx_onenand_dma_release();
 	if (onenand->ahb_addr)
 		iounmap(onenand->ahb_addr);
 	if (onenand->ahb_res)
@@ -44,6 +44,7 @@
 #include <linux/kthread.h>
 #include <linux/kernel.h>
 #include <linux/slab.h>
+#include <linux/reboot.h>
 #include "ubi.h"
 
 /* Maximum length of the 'mtd=' parameter */
@@ -575,19 +576,24 @@ static void free_internal_volumes(struct ubi_device *ubi)
  * This function returns zero in case of success and a negative error code in
  * case of failure.
  *
- * Note, currently this is the only method to attach UBI devices. Hopefully in
- * the future we'll have more scalable attaching methods and avoid full media
- * scanning. But even in this case scanning will be needed as a fall-back
- * attaching method if there are some on-flash table corruptions.
+ * If the attach snapshot is enabled and valid, the scanning information is
+ * taken from it. Otherwise, or if the snapshot is invalid, the whole media is
+ * scanned.
  */
 static int attach_by_scanning(struct ubi_device *ubi)
 {
 	int err;
 	struct ubi_scan_info *si;
 
-	si = ubi_scan(ubi);
-	if (IS_ERR(si))
-		return PTR_ERR(si);
+	si = ubi_snapshot_scan(ubi);
+	if (IS_ERR(si)) {
+		if (PTR_ERR(si) != -ENOENT)
+			ubi_warn("cannot use attach snapshot, error %d",
+				 (int)PTR_ERR(si));
+		si = ubi_scan(ubi);
+		if (IS_ERR(si))
+			return PTR_ERR(si);
+	}
 
 	ubi->bad_peb_count = si->bad_peb_count;
 	ubi->good_peb_count = ubi->peb_count - ubi->bad_peb_count;
@@ -919,6 +925,9 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num, int vid_hdr_offset)
 	mutex_init(&ubi->ckvol_mutex);
 	mutex_init(&ubi->device_mutex);
 	spin_lock_init(&ubi->volumes_lock);
+#ifdef CONFIG_MTD_UBI_ATTACH_SNAPSHOT
+	init_rwsem(&ubi->snap_sem);
+#endif
 
 	ubi_msg("attaching mtd%d to ubi%d", mtd->index, ubi_num);
 
@@ -1063,8 +1072,10 @@ int ubi_detach_mtd_dev(int ubi_num, int anyway)
 	 * Before freeing anything, we have to stop the background thread to
 	 * prevent it from doing anything on this device while we are freeing.
 	 */
-	if (ubi->bgt_thread)
+	if (ubi->bgt_thread) {
 		kthread_stop(ubi->bgt_thread);
+		ubi->thread_enabled = 0;
+	}
 
 	/*
 	 * Get a reference to the device in order to prevent 'dev_release()'
@@ -1072,6 +1083,17 @@ int ubi_detach_mtd_dev(int ubi_num, int anyway)
 	 */
 	get_device(&ubi->dev);
 
+	/*
+	 * Nothing can change the device any more, so it is the right time to
+	 * write the attach snapshot.
+	 */
+	if (!ubi->ref_count) {
+		int err = ubi_snapshot_write(ubi);
+
+		if (err)
+			ubi_warn("attach snapshot not written, error %d", err);
+	}
+
 	uif_close(ubi);
 	ubi_wl_close(ubi);
 	free_internal_volumes(ubi);
@@ -1155,6 +1177,39 @@ static struct mtd_info * __init open_mtd_device(const char *mtd_dev)
 	return mtd;
 }
 
+#ifdef CONFIG_MTD_UBI_ATTACH_SNAPSHOT
+/**
+ * ubi_reboot_notify - write attach snapshots at reboot, halt or power off.
+ * @nb: the reboot notifier
+ * @event: reboot event
+ * @unused: unused
+ *
+ * When UBI is built in and the root or system file-system lives on it, the
+ * devices are never detached, so the snapshot has to be written here. The
+ * devices are read-only afterwards.
+ */
+static int ubi_reboot_notify(struct notifier_block *nb, unsigned long event,
+			     void *unused)
+{
+	int i;
+	struct ubi_device *ubi;
+
+	for (i = 0; i < UBI_MAX_DEVICES; i++) {
+		ubi = ubi_get_device(i);
+		if (!ubi)
+			continue;
+		ubi_snapshot_freeze(ubi);
+		ubi_put_device(ubi);
+	}
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block ubi_reboot_notifier = {
+	.notifier_call = ubi_reboot_notify,
+};
+#endif
+
 static int __init ubi_init(void)
 {
 	int err, i, k;
@@ -1233,6 +1288,9 @@ static int __init ubi_init(void)
 		}
 	}
 
+#ifdef CONFIG_MTD_UBI_ATTACH_SNAPSHOT
+	register_reboot_notifier(&ubi_reboot_notifier);
+#endif
 	return 0;
 
 out_detach:
@@ -1259,6 +1317,9 @@ static void __exit ubi_exit(void)
 {
 	int i;
 
+#ifdef CONFIG_MTD_UBI_ATTACH_SNAPSHOT
+	unregister_reboot_notifier(&ubi_reboot_notifier);
+#endif
 	for (i = 0; i < UBI_MAX_DEVICES; i++)
 		if (ubi_devices[i]) {
 			mutex_lock(&ubi_devices_mutex);
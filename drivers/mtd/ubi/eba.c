@@ -50,14 +50,14 @@
 #define EBA_RESERVED_PEBS 1
 
 /**
- * next_sqnum - get next sequence number.
+ * ubi_next_sqnum - get next sequence number.
  * @ubi: UBI device description object
  *
  * This function returns next sequence number to use, which is just the current
  * global sequence counter value. It also increases the global sequence
  * counter.
  */
-static unsigned long long next_sqnum(struct ubi_device *ubi)
+unsigned long long ubi_next_sqnum(struct ubi_device *ubi)
 {
 	unsigned long long sqnum;
 
@@ -248,9 +248,16 @@ static int leb_write_lock(struct ubi_device *ubi, int vol_id, int lnum)
 {
 	struct ubi_ltree_entry *le;
 
+#ifdef CONFIG_MTD_UBI_ATTACH_SNAPSHOT
+	down_read(&ubi->snap_sem);
+#endif
 	le = ltree_add_entry(ubi, vol_id, lnum);
-	if (IS_ERR(le))
+	if (IS_ERR(le)) {
+#ifdef CONFIG_MTD_UBI_ATTACH_SNAPSHOT
+		up_read(&ubi->snap_sem);
+#endif
 		return PTR_ERR(le);
+	}
 	down_write(&le->mutex);
 	return 0;
 }
@@ -270,9 +277,21 @@ static int leb_write_trylock(struct ubi_device *ubi, int vol_id, int lnum)
 {
 	struct ubi_ltree_entry *le;
 
+#ifdef CONFIG_MTD_UBI_ATTACH_SNAPSHOT
+	/*
+	 * This is called by the WL worker, which must not wait for the
+	 * snapshot writer: the latter waits for the worker.
+	 */
+	if (!down_read_trylock(&ubi->snap_sem))
+		return 1;
+#endif
 	le = ltree_add_entry(ubi, vol_id, lnum);
-	if (IS_ERR(le))
+	if (IS_ERR(le)) {
+#ifdef CONFIG_MTD_UBI_ATTACH_SNAPSHOT
+		up_read(&ubi->snap_sem);
+#endif
 		return PTR_ERR(le);
+	}
 	if (down_write_trylock(&le->mutex))
 		return 0;
 
@@ -285,6 +304,9 @@ static int leb_write_trylock(struct ubi_device *ubi, int vol_id, int lnum)
 		kfree(le);
 	}
 	spin_unlock(&ubi->ltree_lock);
+#ifdef CONFIG_MTD_UBI_ATTACH_SNAPSHOT
+	up_read(&ubi->snap_sem);
+#endif
 
 	return 1;
 }
@@ -309,6 +331,9 @@ static void leb_write_unlock(struct ubi_device *ubi, int vol_id, int lnum)
 		kfree(le);
 	}
 	spin_unlock(&ubi->ltree_lock);
+#ifdef CONFIG_MTD_UBI_ATTACH_SNAPSHOT
+	up_read(&ubi->snap_sem);
+#endif
 }
 
 /**
@@ -521,7 +546,7 @@ retry:
 		goto out_put;
 	}
 
-	vid_hdr->sqnum = cpu_to_be64(next_sqnum(ubi));
+	vid_hdr->sqnum = cpu_to_be64(ubi_next_sqnum(ubi));
 	err = ubi_io_write_vid_hdr(ubi, new_pnum, vid_hdr);
 	if (err)
 		goto write_error;
@@ -633,7 +658,7 @@ int ubi_eba_write_leb(struct ubi_device *ubi, struct ubi_volume *vol, int lnum,
 	}
 
 	vid_hdr->vol_type = UBI_VID_DYNAMIC;
-	vid_hdr->sqnum = cpu_to_be64(next_sqnum(ubi));
+	vid_hdr->sqnum = cpu_to_be64(ubi_next_sqnum(ubi));
 	vid_hdr->vol_id = cpu_to_be32(vol_id);
 	vid_hdr->lnum = cpu_to_be32(lnum);
 	vid_hdr->compat = ubi_get_compat(ubi, vol_id);
@@ -694,7 +719,7 @@ write_error:
 		return err;
 	}
 
-	vid_hdr->sqnum = cpu_to_be64(next_sqnum(ubi));
+	vid_hdr->sqnum = cpu_to_be64(ubi_next_sqnum(ubi));
 	ubi_msg("try another PEB");
 	goto retry;
 }
@@ -749,7 +774,7 @@ int ubi_eba_write_leb_st(struct ubi_device *ubi, struct ubi_volume *vol,
 		return err;
 	}
 
-	vid_hdr->sqnum = cpu_to_be64(next_sqnum(ubi));
+	vid_hdr->sqnum = cpu_to_be64(ubi_next_sqnum(ubi));
 	vid_hdr->vol_id = cpu_to_be32(vol_id);
 	vid_hdr->lnum = cpu_to_be32(lnum);
 	vid_hdr->compat = ubi_get_compat(ubi, vol_id);
@@ -814,7 +839,7 @@ write_error:
 		return err;
 	}
 
-	vid_hdr->sqnum = cpu_to_be64(next_sqnum(ubi));
+	vid_hdr->sqnum = cpu_to_be64(ubi_next_sqnum(ubi));
 	ubi_msg("try another PEB");
 	goto retry;
 }
@@ -867,7 +892,7 @@ int ubi_eba_atomic_leb_change(struct ubi_device *ubi, struct ubi_volume *vol,
 	if (err)
 		goto out_mutex;
 
-	vid_hdr->sqnum = cpu_to_be64(next_sqnum(ubi));
+	vid_hdr->sqnum = cpu_to_be64(ubi_next_sqnum(ubi));
 	vid_hdr->vol_id = cpu_to_be32(vol_id);
 	vid_hdr->lnum = cpu_to_be32(lnum);
 	vid_hdr->compat = ubi_get_compat(ubi, vol_id);
@@ -935,7 +960,7 @@ write_error:
 		goto out_leb_unlock;
 	}
 
-	vid_hdr->sqnum = cpu_to_be64(next_sqnum(ubi));
+	vid_hdr->sqnum = cpu_to_be64(ubi_next_sqnum(ubi));
 	ubi_msg("try another PEB");
 	goto retry;
 }
@@ -1093,7 +1118,7 @@ int ubi_eba_copy_leb(struct ubi_device *ubi, int from, int to,
 		vid_hdr->data_size = cpu_to_be32(data_size);
 		vid_hdr->data_crc = cpu_to_be32(crc);
 	}
-	vid_hdr->sqnum = cpu_to_be64(next_sqnum(ubi));
+	vid_hdr->sqnum = cpu_to_be64(ubi_next_sqnum(ubi));
 
 	err = ubi_io_write_vid_hdr(ubi, to, vid_hdr);
 	if (err) {
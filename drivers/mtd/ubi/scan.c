@@ -829,6 +829,29 @@ static int process_eb(struct ubi_device *ubi, struct ubi_scan_info *si,
 	}
 
 	vol_id = be32_to_cpu(vidh->vol_id);
+	if (vol_id == UBI_SNAP_VOLUME_ID) {
+		/*
+		 * A left-over of the attach snapshot. It is either stale or
+		 * was not used, so it is not needed any more. The anchor has
+		 * to go right now: if it was still there when power is cut
+		 * after new data has been written, the next attach would trust
+		 * the stale snapshot.
+		 */
+		dbg_bld("snapshot LEB %d found", be32_to_cpu(vidh->lnum));
+		if (be32_to_cpu(vidh->lnum) == 0) {
+			err = ubi_io_sync_erase(ubi, pnum, 0);
+			if (err < 0) {
+				ubi_err("cannot erase snapshot anchor PEB %d",
+					pnum);
+				return err;
+			}
+		}
+		err = add_to_list(si, pnum, ec, &si->erase);
+		if (err)
+			return err;
+		goto adjust_mean_ec;
+	}
+
 	if (vol_id > UBI_MAX_VOLUMES && vol_id != UBI_LAYOUT_VOLUME_ID) {
 		int lnum = be32_to_cpu(vidh->lnum);
 
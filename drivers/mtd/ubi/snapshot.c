@@ -0,0 +1,661 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See
+ * the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ */
+
+/*
+ * UBI attach snapshot.
+ *
+ * Attaching by scanning has to read the EC and VID headers of every physical
+ * eraseblock, so it takes time proportional to the flash size. To avoid this
+ * on the common path, UBI stores a snapshot of the scanning information when
+ * the device is cleanly detached, or at reboot and power off if it is still
+ * attached then. The snapshot records the erase counter and
+ * the (volume ID, LEB number) pair of every physical eraseblock, as well as
+ * the few per-volume values which are normally taken from VID headers. See
+ * &struct ubi_snap_hdr for the on-flash format.
+ *
+ * On the next attach UBI reads the headers of the first %UBI_SNAP_MAX_START
+ * physical eraseblocks only, looking for the snapshot anchor. If it is found
+ * and is consistent, the scanning information is re-built from the snapshot
+ * and the anchor is erased straight away, before anything else is written to
+ * the device. This guarantees that a snapshot found on the flash always
+ * describes the current state of the device: if UBI was not detached cleanly,
+ * there is no snapshot and UBI falls back to full scanning, which throws the
+ * left-over snapshot eraseblocks away. The same happens if an anchor is found
+ * but the snapshot cannot be used; the full scan then erases the anchor
+ * synchronously, before anything else is written to the device.
+ *
+ * Note, the snapshot is written at detach, reboot or power off time only.
+ * Writing it periodically would require recording every PEB which may change
+ * afterwards, which this UBI implementation cannot do. For the same reason,
+ * once the snapshot has been written at reboot, the device is switched to
+ * read-only mode, so that nothing changes the flash under the snapshot.
+ */
+
+#include <linux/err.h>
+#include <linux/slab.h>
+#include <linux/crc32.h>
+#include <linux/math64.h>
+#include <linux/vmalloc.h>
+#include "ubi.h"
+
+/**
+ * add_to_list - add physical eraseblock to a scanning information list.
+ * @list: the list to add to
+ * @pnum: physical eraseblock number to add
+ * @ec: erase counter of the physical eraseblock
+ *
+ * Returns zero in case of success and %-ENOMEM in case of failure.
+ */
+static int add_to_list(struct list_head *list, int pnum, int ec)
+{
+	struct ubi_scan_leb *seb;
+
+	seb = kmalloc(sizeof(struct ubi_scan_leb), GFP_KERNEL);
+	if (!seb)
+		return -ENOMEM;
+
+	seb->pnum = pnum;
+	seb->ec = ec;
+	list_add_tail(&seb->u.list, list);
+	return 0;
+}
+
+/**
+ * snap_vol_idx - get index of a volume record in the volume record table.
+ * @vol_id: volume ID
+ *
+ * Returns the index or %-1 if @vol_id cannot be stored in the snapshot.
+ */
+static int snap_vol_idx(int vol_id)
+{
+	if (vol_id >= 0 && vol_id < UBI_MAX_VOLUMES)
+		return vol_id;
+	if (vol_id == UBI_LAYOUT_VOLUME_ID)
+		return UBI_MAX_VOLUMES;
+	return -1;
+}
+
+/**
+ * find_anchor - find the attach snapshot anchor.
+ * @ubi: UBI device description object
+ * @vid_hdr: VID header of the anchor is returned here
+ * @ec: erase counter of the anchor is returned here
+ *
+ * This function looks at the first %UBI_SNAP_MAX_START physical eraseblocks
+ * and returns the number of the one which contains LEB 0 of the snapshot
+ * volume. Returns %-ENOENT if there is no such physical eraseblock and a
+ * negative error code in case of failure.
+ */
+static int find_anchor(struct ubi_device *ubi, struct ubi_vid_hdr *vid_hdr,
+		       int *ec)
+{
+	int err, pnum;
+	struct ubi_ec_hdr *ec_hdr;
+
+	ec_hdr = kzalloc(ubi->ec_hdr_alsize, GFP_KERNEL);
+	if (!ec_hdr)
+		return -ENOMEM;
+
+	for (pnum = 0; pnum < ubi->peb_count && pnum < UBI_SNAP_MAX_START;
+	     pnum++) {
+		err = ubi_io_is_bad(ubi, pnum);
+		if (err < 0)
+			goto out_free;
+		else if (err)
+			continue;
+
+		err = ubi_io_read_ec_hdr(ubi, pnum, ec_hdr, 0);
+		if (err < 0)
+			goto out_free;
+		else if (err && err != UBI_IO_BITFLIPS)
+			continue;
+		if (ec_hdr->version != UBI_VERSION)
+			continue;
+
+		err = ubi_io_read_vid_hdr(ubi, pnum, vid_hdr, 0);
+		if (err < 0)
+			goto out_free;
+		else if (err && err != UBI_IO_BITFLIPS)
+			continue;
+
+		if (be32_to_cpu(vid_hdr->vol_id) == UBI_SNAP_VOLUME_ID &&
+		    be32_to_cpu(vid_hdr->lnum) == 0) {
+			*ec = be64_to_cpu(ec_hdr->ec);
+			if (*ec > UBI_MAX_ERASECOUNTER) {
+				err = -EINVAL;
+				goto out_free;
+			}
+			err = pnum;
+			goto out_free;
+		}
+	}
+	err = -ENOENT;
+
+out_free:
+	kfree(ec_hdr);
+	return err;
+}
+
+/**
+ * read_snapshot - read and check the attach snapshot.
+ * @ubi: UBI device description object
+ * @anchor: the anchor physical eraseblock
+ * @sqnum: sequence number of the anchor VID header
+ * @vid_hdr: VID header buffer to use
+ *
+ * This function reads the whole snapshot and checks its CRC checksums.
+ * Returns a pointer to the vmalloc'ed snapshot in case of success and an
+ * error code in case of failure.
+ */
+static void *read_snapshot(struct ubi_device *ubi, int anchor,
+			   unsigned long long sqnum,
+			   struct ubi_vid_hdr *vid_hdr)
+{
+	int i, err, pnum, peb_nr, size, len;
+	uint32_t crc;
+	void *buf;
+	struct ubi_snap_hdr *hdr;
+
+	buf = vmalloc(UBI_SNAP_MAX_PEBS * ubi->leb_size);
+	if (!buf)
+		return ERR_PTR(-ENOMEM);
+
+	err = ubi_io_read_data(ubi, buf, anchor, 0, ubi->leb_size);
+	if (err && err != UBI_IO_BITFLIPS)
+		goto out_free;
+
+	err = -EINVAL;
+	hdr = buf;
+	crc = crc32(UBI_CRC32_INIT, hdr, sizeof(struct ubi_snap_hdr) -
+		    sizeof(__be32));
+	if (be32_to_cpu(hdr->magic) != UBI_SNAP_MAGIC ||
+	    hdr->version != UBI_SNAP_FORMAT_VERSION ||
+	    be32_to_cpu(hdr->hdr_crc) != crc) {
+		dbg_bld("bad snapshot header in PEB %d", anchor);
+		goto out_free;
+	}
+
+	peb_nr = be32_to_cpu(hdr->peb_nr);
+	size = be32_to_cpu(hdr->data_size);
+	if (be32_to_cpu(hdr->peb_count) != ubi->peb_count ||
+	    be32_to_cpu(hdr->vol_count) > UBI_MAX_VOLUMES + UBI_INT_VOL_COUNT ||
+	    peb_nr < 1 || peb_nr > UBI_SNAP_MAX_PEBS ||
+	    be32_to_cpu(hdr->snap_pebs[0]) != anchor ||
+	    size != sizeof(struct ubi_snap_hdr) +
+		    be32_to_cpu(hdr->vol_count) * sizeof(struct ubi_snap_vol) +
+		    ubi->peb_count * sizeof(struct ubi_snap_peb) ||
+	    DIV_ROUND_UP(size, ubi->leb_size) != peb_nr) {
+		dbg_bld("inconsistent snapshot header in PEB %d", anchor);
+		goto out_free;
+	}
+
+	for (i = 1; i < peb_nr; i++) {
+		pnum = be32_to_cpu(hdr->snap_pebs[i]);
+		if (pnum < 0 || pnum >= ubi->peb_count)
+			goto out_free;
+
+		err = ubi_io_read_vid_hdr(ubi, pnum, vid_hdr, 0);
+		if (err < 0)
+			goto out_free;
+		err = -EINVAL;
+		if (be32_to_cpu(vid_hdr->vol_id) != UBI_SNAP_VOLUME_ID ||
+		    be32_to_cpu(vid_hdr->lnum) != i ||
+		    be64_to_cpu(vid_hdr->sqnum) >= sqnum) {
+			dbg_bld("bad snapshot LEB %d in PEB %d", i, pnum);
+			goto out_free;
+		}
+
+		len = min_t(int, ubi->leb_size, size - i * ubi->leb_size);
+		err = ubi_io_read_data(ubi, buf + i * ubi->leb_size, pnum, 0,
+				       len);
+		if (err && err != UBI_IO_BITFLIPS)
+			goto out_free;
+	}
+
+	crc = crc32(UBI_CRC32_INIT, buf + sizeof(struct ubi_snap_hdr),
+		    size - sizeof(struct ubi_snap_hdr));
+	if (be32_to_cpu(hdr->data_crc) != crc) {
+		dbg_bld("bad snapshot data CRC");
+		err = -EINVAL;
+		goto out_free;
+	}
+
+	return buf;
+
+out_free:
+	vfree(buf);
+	return ERR_PTR(err);
+}
+
+/**
+ * ubi_snapshot_scan - build scanning information from the attach snapshot.
+ * @ubi: UBI device description object
+ *
+ * This function looks for the attach snapshot, and if it is found and valid,
+ * returns the scanning information built from it. The snapshot is erased
+ * before returning. In case of failure an error code is returned, in which
+ * case the caller has to fall back to scanning.
+ */
+struct ubi_scan_info *ubi_snapshot_scan(struct ubi_device *ubi)
+{
+	int i, err, anchor, anchor_ec, vol_count;
+	unsigned long long sqnum;
+	void *buf;
+	struct ubi_snap_hdr *hdr;
+	struct ubi_snap_vol *svol, **vols = NULL;
+	struct ubi_snap_peb *speb;
+	struct ubi_vid_hdr *vid_hdr;
+	struct ubi_scan_info *si;
+
+	vid_hdr = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
+	if (!vid_hdr)
+		return ERR_PTR(-ENOMEM);
+
+	anchor = find_anchor(ubi, vid_hdr, &anchor_ec);
+	if (anchor < 0) {
+		err = anchor;
+		goto out_vid_hdr;
+	}
+	sqnum = be64_to_cpu(vid_hdr->sqnum);
+
+	buf = read_snapshot(ubi, anchor, sqnum, vid_hdr);
+	if (IS_ERR(buf)) {
+		err = PTR_ERR(buf);
+		goto out_vid_hdr;
+	}
+	hdr = buf;
+	vol_count = be32_to_cpu(hdr->vol_count);
+	svol = buf + sizeof(struct ubi_snap_hdr);
+	speb = (void *)(svol + vol_count);
+
+	err = -ENOMEM;
+	vols = kcalloc(UBI_MAX_VOLUMES + UBI_INT_VOL_COUNT,
+		       sizeof(struct ubi_snap_vol *), GFP_KERNEL);
+	if (!vols)
+		goto out_buf;
+
+	si = kzalloc(sizeof(struct ubi_scan_info), GFP_KERNEL);
+	if (!si)
+		goto out_vols;
+
+	INIT_LIST_HEAD(&si->corr);
+	INIT_LIST_HEAD(&si->free);
+	INIT_LIST_HEAD(&si->erase);
+	INIT_LIST_HEAD(&si->alien);
+	si->volumes = RB_ROOT;
+	si->min_ec = UBI_MAX_ERASECOUNTER;
+	si->max_sqnum = max_t(unsigned long long, sqnum,
+			      be64_to_cpu(hdr->sqnum));
+
+	err = -EINVAL;
+	for (i = 0; i < vol_count; i++) {
+		int idx = snap_vol_idx(be32_to_cpu(svol[i].vol_id));
+
+		if (idx < 0 || vols[idx])
+			goto out_si;
+		vols[idx] = &svol[i];
+	}
+
+	for (i = 0; i < ubi->peb_count; i++) {
+		int vol_id = be32_to_cpu(speb[i].vol_id);
+		int ec = be32_to_cpu(speb[i].ec);
+
+		if (vol_id == UBI_SNAP_PEB_BAD) {
+			si->bad_peb_count += 1;
+			continue;
+		}
+
+		err = -EINVAL;
+		if (ec < 0 || ec > UBI_MAX_ERASECOUNTER)
+			goto out_si;
+
+		if (i == anchor) {
+			/* Handled below */
+			ec = anchor_ec;
+			err = 0;
+		} else if (vol_id == UBI_SNAP_PEB_FREE)
+			err = add_to_list(&si->free, i, ec);
+		else if (vol_id == UBI_SNAP_PEB_ERASE)
+			err = add_to_list(&si->erase, i, ec);
+		else {
+			int idx = snap_vol_idx(vol_id);
+			int lnum = be32_to_cpu(speb[i].lnum);
+			int used_ebs;
+
+			if (idx < 0 || !vols[idx] || lnum < 0)
+				goto out_si;
+			svol = vols[idx];
+			used_ebs = be32_to_cpu(svol->used_ebs);
+
+			memset(vid_hdr, 0, sizeof(struct ubi_vid_hdr));
+			vid_hdr->vol_type = svol->vol_type;
+			vid_hdr->compat = svol->compat;
+			vid_hdr->vol_id = cpu_to_be32(vol_id);
+			vid_hdr->lnum = cpu_to_be32(lnum);
+			vid_hdr->data_pad = svol->data_pad;
+			if (svol->vol_type == UBI_VID_STATIC) {
+				vid_hdr->used_ebs = svol->used_ebs;
+				if (lnum == used_ebs - 1)
+					vid_hdr->data_size =
+						svol->last_eb_bytes;
+				else
+					vid_hdr->data_size = cpu_to_be32(
+						ubi->leb_size -
+						be32_to_cpu(svol->data_pad));
+			}
+
+			err = ubi_scan_add_used(ubi, si, i, ec, vid_hdr, 0);
+		}
+		if (err)
+			goto out_si;
+
+		si->ec_sum += ec;
+		si->ec_count += 1;
+		if (ec > si->max_ec)
+			si->max_ec = ec;
+		if (ec < si->min_ec)
+			si->min_ec = ec;
+	}
+
+	if (si->bad_peb_count != be32_to_cpu(hdr->bad_peb_count)) {
+		err = -EINVAL;
+		goto out_si;
+	}
+	if (si->ec_count)
+		si->mean_ec = div_u64(si->ec_sum, si->ec_count);
+	ubi->image_seq = be32_to_cpu(hdr->image_seq);
+
+	/*
+	 * Erase the anchor before anything else is written to the device, so
+	 * that the snapshot is not used again after this attach.
+	 */
+	err = ubi_scan_erase_peb(ubi, si, anchor, anchor_ec + 1);
+	if (err)
+		goto out_si;
+	err = add_to_list(&si->free, anchor, anchor_ec + 1);
+	if (err)
+		goto out_si;
+
+	ubi_msg("attached using snapshot in PEB %d", anchor);
+	kfree(vols);
+	vfree(buf);
+	ubi_free_vid_hdr(ubi, vid_hdr);
+	return si;
+
+out_si:
+	ubi_scan_destroy_si(si);
+out_vols:
+	kfree(vols);
+out_buf:
+	vfree(buf);
+out_vid_hdr:
+	ubi_free_vid_hdr(ubi, vid_hdr);
+	return ERR_PTR(err);
+}
+
+/**
+ * fill_peb_records - fill physical eraseblock records of the snapshot.
+ * @ubi: UBI device description object
+ * @speb: the records to fill
+ *
+ * Returns zero in case of success and a negative error code in case of
+ * failure, e.g. if there are physical eraseblocks unknown to UBI.
+ */
+static int fill_peb_records(struct ubi_device *ubi, struct ubi_snap_peb *speb)
+{
+	int i, err, lnum;
+	struct rb_node *rb;
+	struct ubi_wl_entry *e;
+	struct ubi_volume *vol;
+
+	/*
+	 * Either the device is being detached, or 'ubi_snapshot_freeze()'
+	 * holds off LEB writers and the WL worker, so the WL and EBA state
+	 * cannot change under us. Every PEB known to the WL sub-system which
+	 * is neither free nor mapped is going to be erased.
+	 */
+	spin_lock(&ubi->wl_lock);
+	for (i = 0; i < ubi->peb_count; i++) {
+		e = ubi->lookuptbl[i];
+		if (e) {
+			speb[i].ec = cpu_to_be32(e->ec);
+			speb[i].vol_id = cpu_to_be32(UBI_SNAP_PEB_ERASE);
+		} else
+			speb[i].vol_id = cpu_to_be32(UBI_SNAP_PEB_BAD);
+	}
+	ubi_rb_for_each_entry(rb, e, &ubi->free, u.rb)
+		speb[e->pnum].vol_id = cpu_to_be32(UBI_SNAP_PEB_FREE);
+	spin_unlock(&ubi->wl_lock);
+
+	for (i = 0; i < ubi->peb_count; i++) {
+		if (be32_to_cpu(speb[i].vol_id) != UBI_SNAP_PEB_BAD)
+			continue;
+
+		err = ubi_io_is_bad(ubi, i);
+		if (err < 0)
+			return err;
+		if (!err) {
+			/* E.g., a PEB of a "preserve" internal volume */
+			dbg_msg("PEB %d is unknown to UBI", i);
+			return -EINVAL;
+		}
+	}
+
+	for (i = 0; i < ubi->vtbl_slots + UBI_INT_VOL_COUNT; i++) {
+		vol = ubi->volumes[i];
+		if (!vol)
+			continue;
+
+		for (lnum = 0; lnum < vol->reserved_pebs; lnum++) {
+			int pnum = vol->eba_tbl[lnum];
+
+			if (pnum < 0)
+				continue;
+			speb[pnum].vol_id = cpu_to_be32(vol->vol_id);
+			speb[pnum].lnum = cpu_to_be32(lnum);
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * ubi_snapshot_write - write the attach snapshot.
+ * @ubi: UBI device description object
+ *
+ * This function is called when the UBI device is being detached, after the
+ * background thread has been stopped, or by 'ubi_snapshot_freeze()'. It
+ * writes the snapshot to free physical eraseblocks, writing the anchor last.
+ * Returns zero in case of success and a negative error code in case of
+ * failure. Failing to write the snapshot is not fatal - the next attach falls
+ * back to scanning.
+ */
+int ubi_snapshot_write(struct ubi_device *ubi)
+{
+	int i, err, size, peb_nr, got = 0, vol_count = 0;
+	int snap_pebs[UBI_SNAP_MAX_PEBS];
+	void *buf;
+	struct ubi_snap_hdr *hdr;
+	struct ubi_snap_vol *svol;
+	struct ubi_snap_peb *speb;
+	struct ubi_vid_hdr *vid_hdr;
+	struct ubi_volume *vol;
+
+	BUILD_BUG_ON(sizeof(struct ubi_snap_hdr) != 128);
+
+	if (ubi->ro_mode)
+		return 0;
+
+	for (i = 0; i < ubi->vtbl_slots + UBI_INT_VOL_COUNT; i++)
+		if (ubi->volumes[i])
+			vol_count += 1;
+
+	size = sizeof(struct ubi_snap_hdr) +
+	       vol_count * sizeof(struct ubi_snap_vol) +
+	       ubi->peb_count * sizeof(struct ubi_snap_peb);
+	peb_nr = DIV_ROUND_UP(size, ubi->leb_size);
+	if (peb_nr > UBI_SNAP_MAX_PEBS) {
+		ubi_warn("snapshot needs %d PEBs, max. is %d", peb_nr,
+			 UBI_SNAP_MAX_PEBS);
+		return -EINVAL;
+	}
+
+	buf = vmalloc(peb_nr * ubi->leb_size);
+	if (!buf)
+		return -ENOMEM;
+	memset(buf, 0, peb_nr * ubi->leb_size);
+
+	err = -ENOMEM;
+	vid_hdr = ubi_zalloc_vid_hdr(ubi, GFP_KERNEL);
+	if (!vid_hdr)
+		goto out_buf;
+
+	/* The anchor goes first, it has to be at the beginning of the flash */
+	for (i = 0; i < peb_nr; i++) {
+		err = ubi_wl_get_snapshot_peb(ubi, i ? ubi->peb_count :
+					      UBI_SNAP_MAX_START);
+		if (err < 0) {
+			dbg_msg("no free PEB for snapshot LEB %d", i);
+			goto out_vid_hdr;
+		}
+		snap_pebs[i] = err;
+		got += 1;
+	}
+
+	hdr = buf;
+	svol = buf + sizeof(struct ubi_snap_hdr);
+	speb = (void *)(svol + vol_count);
+
+	err = fill_peb_records(ubi, speb);
+	if (err)
+		goto out_vid_hdr;
+
+	for (i = 0; i < ubi->vtbl_slots + UBI_INT_VOL_COUNT; i++) {
+		vol = ubi->volumes[i];
+		if (!vol)
+			continue;
+
+		svol->vol_id = cpu_to_be32(vol->vol_id);
+		svol->used_ebs = cpu_to_be32(vol->used_ebs);
+		svol->last_eb_bytes = cpu_to_be32(vol->last_eb_bytes);
+		svol->data_pad = cpu_to_be32(vol->data_pad);
+		if (vol->vol_type == UBI_DYNAMIC_VOLUME)
+			svol->vol_type = UBI_VID_DYNAMIC;
+		else
+			svol->vol_type = UBI_VID_STATIC;
+		if (vol->vol_id == UBI_LAYOUT_VOLUME_ID)
+			svol->compat = UBI_LAYOUT_VOLUME_COMPAT;
+		svol += 1;
+	}
+
+	for (i = 0; i < ubi->peb_count; i++)
+		if (be32_to_cpu(speb[i].vol_id) == UBI_SNAP_PEB_BAD)
+			hdr->bad_peb_count =
+				cpu_to_be32(be32_to_cpu(hdr->bad_peb_count) + 1);
+
+	hdr->magic = cpu_to_be32(UBI_SNAP_MAGIC);
+	hdr->version = UBI_SNAP_FORMAT_VERSION;
+	hdr->peb_count = cpu_to_be32(ubi->peb_count);
+	hdr->vol_count = cpu_to_be32(vol_count);
+	hdr->peb_nr = cpu_to_be32(peb_nr);
+	hdr->image_seq = cpu_to_be32(ubi->image_seq);
+	hdr->data_size = cpu_to_be32(size);
+	hdr->data_crc = cpu_to_be32(crc32(UBI_CRC32_INIT,
+					  buf + sizeof(struct ubi_snap_hdr),
+					  size - sizeof(struct ubi_snap_hdr)));
+	hdr->sqnum = cpu_to_be64(ubi->global_sqnum);
+	for (i = 0; i < peb_nr; i++)
+		hdr->snap_pebs[i] = cpu_to_be32(snap_pebs[i]);
+	hdr->hdr_crc = cpu_to_be32(crc32(UBI_CRC32_INIT, hdr,
+					 sizeof(struct ubi_snap_hdr) -
+					 sizeof(__be32)));
+
+	/*
+	 * Write the anchor last, so that a partially written snapshot is never
+	 * found at attach time.
+	 */
+	vid_hdr->vol_type = UBI_SNAP_VOLUME_TYPE;
+	vid_hdr->compat = UBI_SNAP_VOLUME_COMPAT;
+	vid_hdr->vol_id = cpu_to_be32(UBI_SNAP_VOLUME_ID);
+	for (i = peb_nr - 1; i >= 0; i--) {
+		int len = min_t(int, ubi->leb_size, size - i * ubi->leb_size);
+
+		vid_hdr->lnum = cpu_to_be32(i);
+		vid_hdr->sqnum = cpu_to_be64(ubi_next_sqnum(ubi));
+		err = ubi_io_write_vid_hdr(ubi, snap_pebs[i], vid_hdr);
+		if (err)
+			goto out_vid_hdr;
+
+		err = ubi_io_write_data(ubi, buf + i * ubi->leb_size,
+					snap_pebs[i], 0,
+					ALIGN(len, ubi->min_io_size));
+		if (err)
+			goto out_vid_hdr;
+	}
+
+	dbg_msg("snapshot written, anchor PEB %d", snap_pebs[0]);
+
+out_vid_hdr:
+	/* The device may stay in use, give the PEBs back */
+	if (err && ubi->thread_enabled)
+		for (i = 0; i < got; i++)
+			ubi_wl_put_peb(ubi, snap_pebs[i], 0);
+	ubi_free_vid_hdr(ubi, vid_hdr);
+out_buf:
+	vfree(buf);
+	return err;
+}
+
+/**
+ * ubi_snapshot_freeze - write the attach snapshot of a device in use.
+ * @ubi: UBI device description object
+ *
+ * This function is called at reboot, halt and power off, when the device is
+ * still attached and may still be written to. It waits for the volume
+ * management operations, LEB writers and the WL worker in progress, writes
+ * the snapshot and switches the device to read-only mode, so the flash cannot
+ * change after the snapshot any more. Whatever is written to the device after
+ * this point fails with %-EROFS. If the snapshot cannot be written, the
+ * device stays writable and the next attach falls back to scanning.
+ */
+void ubi_snapshot_freeze(struct ubi_device *ubi)
+{
+	int err;
+
+	if (ubi->ro_mode)
+		return;
+
+	/*
+	 * The WL worker only try-locks LEBs, so take @snap_sem first: the
+	 * LEB writers we wait for may need the worker to produce free PEBs.
+	 */
+	mutex_lock(&ubi->device_mutex);
+	down_write(&ubi->snap_sem);
+	down_write(&ubi->work_sem);
+
+	err = ubi_snapshot_write(ubi);
+	if (err)
+		ubi_warn("attach snapshot not written, error %d", err);
+	else {
+		ubi->ro_mode = 1;
+		ubi_msg("attach snapshot written, ubi%d is read-only now",
+			ubi->ubi_num);
+	}
+
+	up_write(&ubi->work_sem);
+	up_write(&ubi->snap_sem);
+	mutex_unlock(&ubi->device_mutex);
+}
@@ -312,6 +312,16 @@ struct ubi_vid_hdr {
 #define UBI_LAYOUT_VOLUME_NAME   "layout volume"
 #define UBI_LAYOUT_VOLUME_COMPAT UBI_COMPAT_REJECT
 
+/*
+ * The snapshot volume contains the attach snapshot. It is not a real volume
+ * and is not counted in %UBI_INT_VOL_COUNT - its eraseblocks are thrown away
+ * as soon as the snapshot was used or found to be stale.
+ */
+
+#define UBI_SNAP_VOLUME_ID     (UBI_INTERNAL_VOL_START + 1)
+#define UBI_SNAP_VOLUME_TYPE   UBI_VID_DYNAMIC
+#define UBI_SNAP_VOLUME_COMPAT UBI_COMPAT_DELETE
+
 /* The maximum number of volumes per one UBI device */
 #define UBI_MAX_VOLUMES 128
 
@@ -375,4 +385,102 @@ struct ubi_vtbl_record {
 	__be32  crc;
 } __attribute__ ((packed));
 
+/* The attach snapshot magic number ("UBIS") */
+#define UBI_SNAP_MAGIC 0x55424953
+
+/* The attach snapshot format version */
+#define UBI_SNAP_FORMAT_VERSION 1
+
+/* The snapshot anchor has to be in one of the first PEBs of the device */
+#define UBI_SNAP_MAX_START 64
+
+/* The maximum count of PEBs the attach snapshot may occupy */
+#define UBI_SNAP_MAX_PEBS 16
+
+/* Special @vol_id values of the attach snapshot PEB records */
+#define UBI_SNAP_PEB_FREE  0xFFFFFFFF
+#define UBI_SNAP_PEB_ERASE 0xFFFFFFFE
+#define UBI_SNAP_PEB_BAD   0xFFFFFFFD
+
+/**
+ * struct ubi_snap_hdr - attach snapshot header.
+ * @magic: attach snapshot magic number (%UBI_SNAP_MAGIC)
+ * @version: attach snapshot format version (%UBI_SNAP_FORMAT_VERSION)
+ * @padding1: reserved for future, zeroes
+ * @peb_count: count of physical eraseblocks on the device
+ * @bad_peb_count: count of bad physical eraseblocks
+ * @vol_count: count of volume records
+ * @peb_nr: count of physical eraseblocks occupied by the snapshot
+ * @image_seq: image sequence number
+ * @data_size: size of the snapshot including this header
+ * @data_crc: CRC32 checksum of the snapshot following this header
+ * @sqnum: the global sequence number at the time the snapshot was taken
+ * @snap_pebs: physical eraseblocks occupied by the snapshot, in LEB order
+ * @padding2: reserved for future, zeroes
+ * @hdr_crc: attach snapshot header CRC checksum
+ *
+ * The attach snapshot describes the state of every physical eraseblock of the
+ * device at the moment it was cleanly detached, so that the next attach does
+ * not have to read the headers of all physical eraseblocks. It is written to
+ * the snapshot volume (%UBI_SNAP_VOLUME_ID) and may span several physical
+ * eraseblocks. The one containing LEB 0 is called the anchor. The anchor is
+ * always one of the first %UBI_SNAP_MAX_START physical eraseblocks of the
+ * device, which is the only area UBI looks at when searching for the snapshot.
+ *
+ * The header is followed by @vol_count &struct ubi_snap_vol records and then
+ * by @peb_count &struct ubi_snap_peb records, one per physical eraseblock.
+ *
+ * The snapshot is invalidated by erasing the anchor before UBI writes anything
+ * to the device, so a snapshot found on the flash is always up-to-date.
+ */
+struct ubi_snap_hdr {
+	__be32  magic;
+	__u8    version;
+	__u8    padding1[3];
+	__be32  peb_count;
+	__be32  bad_peb_count;
+	__be32  vol_count;
+	__be32  peb_nr;
+	__be32  image_seq;
+	__be32  data_size;
+	__be32  data_crc;
+	__be64  sqnum;
+	__be32  snap_pebs[UBI_SNAP_MAX_PEBS];
+	__u8    padding2[16];
+	__be32  hdr_crc;
+} __attribute__ ((packed));
+
+/**
+ * struct ubi_snap_vol - attach snapshot volume record.
+ * @vol_id: volume ID
+ * @used_ebs: how many logical eraseblocks are used by the volume
+ * @last_eb_bytes: how many bytes are stored in the last logical eraseblock
+ * @data_pad: how many bytes at the end of logical eraseblocks are not used
+ * @vol_type: volume type (%UBI_VID_DYNAMIC or %UBI_VID_STATIC)
+ * @compat: compatibility of this volume
+ * @padding: reserved for future, zeroes
+ */
+struct ubi_snap_vol {
+	__be32  vol_id;
+	__be32  used_ebs;
+	__be32  last_eb_bytes;
+	__be32  data_pad;
+	__u8    vol_type;
+	__u8    compat;
+	__u8    padding[2];
+} __attribute__ ((packed));
+
+/**
+ * struct ubi_snap_peb - attach snapshot physical eraseblock record.
+ * @ec: erase counter
+ * @vol_id: ID of the volume this physical eraseblock belongs to, or one of
+ *          %UBI_SNAP_PEB_FREE, %UBI_SNAP_PEB_ERASE, or %UBI_SNAP_PEB_BAD
+ * @lnum: logical eraseblock number mapped to this physical eraseblock
+ */
+struct ubi_snap_peb {
+	__be32  ec;
+	__be32  vol_id;
+	__be32  lnum;
+} __attribute__ ((packed));
+
 #endif /* !__UBI_MEDIA_H__ */
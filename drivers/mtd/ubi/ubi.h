@@ -23,6 +23,7 @@
 #define __UBI_UBI_H__
 
 #include <linux/init.h>
+#include <linux/err.h>
 #include <linux/types.h>
 #include <linux/list.h>
 #include <linux/rbtree.h>
@@ -326,6 +327,8 @@ struct ubi_wl_entry;
  * @ltree_lock: protects the lock tree and @global_sqnum
  * @ltree: the lock tree
  * @alc_mutex: serializes "atomic LEB change" operations
+ * @snap_sem: held for reading by LEB writers, and for writing while the
+ *            attach snapshot is written with the device in use
  *
  * @used: RB-tree of used physical eraseblocks
  * @erroneous: RB-tree of erroneous used physical eraseblocks
@@ -414,6 +417,9 @@ struct ubi_device {
 	spinlock_t ltree_lock;
 	struct rb_root ltree;
 	struct mutex alc_mutex;
+#ifdef CONFIG_MTD_UBI_ATTACH_SNAPSHOT
+	struct rw_semaphore snap_sem;
+#endif
 
 	/* Wear-leveling sub-system's stuff */
 	struct rb_root used;
@@ -522,6 +528,7 @@ int ubi_eba_atomic_leb_change(struct ubi_device *ubi, struct ubi_volume *vol,
 int ubi_eba_copy_leb(struct ubi_device *ubi, int from, int to,
 		     struct ubi_vid_hdr *vid_hdr);
 int ubi_eba_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si);
+unsigned long long ubi_next_sqnum(struct ubi_device *ubi);
 
 /* wl.c */
 int ubi_wl_get_peb(struct ubi_device *ubi, int dtype);
@@ -531,6 +538,9 @@ int ubi_wl_scrub_peb(struct ubi_device *ubi, int pnum);
 int ubi_wl_init_scan(struct ubi_device *ubi, struct ubi_scan_info *si);
 void ubi_wl_close(struct ubi_device *ubi);
 int ubi_thread(void *u);
+#ifdef CONFIG_MTD_UBI_ATTACH_SNAPSHOT
+int ubi_wl_get_snapshot_peb(struct ubi_device *ubi, int max_pnum);
+#endif
 
 /* io.c */
 int ubi_io_read(const struct ubi_device *ubi, void *buf, int pnum, int offset,
@@ -562,6 +572,22 @@ int ubi_notify_all(struct ubi_device *ubi, int ntype,
 		   struct notifier_block *nb);
 int ubi_enumerate_volumes(struct notifier_block *nb);
 
+/* snapshot.c */
+#ifdef CONFIG_MTD_UBI_ATTACH_SNAPSHOT
+struct ubi_scan_info *ubi_snapshot_scan(struct ubi_device *ubi);
+int ubi_snapshot_write(struct ubi_device *ubi);
+void ubi_snapshot_freeze(struct ubi_device *ubi);
+#else
+static inline struct ubi_scan_info *ubi_snapshot_scan(struct ubi_device *ubi)
+{
+	return ERR_PTR(-ENOENT);
+}
+static inline int ubi_snapshot_write(struct ubi_device *ubi)
+{
+	return 0;
+}
+#endif
+
 /* kapi.c */
 void ubi_do_get_device_info(struct ubi_device *ubi, struct ubi_device_info *di);
 void ubi_do_get_volume_info(struct ubi_device *ubi, struct ubi_volume *vol,
@@ -470,6 +470,44 @@ retry:
 	return e->pnum;
 }
 
+#ifdef CONFIG_MTD_UBI_ATTACH_SNAPSHOT
+/**
+ * ubi_wl_get_snapshot_peb - get a free physical eraseblock for the snapshot.
+ * @ubi: UBI device description object
+ * @max_pnum: the returned PEB number has to be less than this
+ *
+ * This function is similar to 'ubi_wl_get_peb()', but it picks the free
+ * physical eraseblock with the lowest erase counter among those which are
+ * below @max_pnum, and it never waits for pending erasures. It is used when
+ * writing the attach snapshot, whose anchor has to live at the beginning of
+ * the flash. Returns the physical eraseblock number in case of success and
+ * %-ENOSPC if there is no suitable free physical eraseblock.
+ */
+int ubi_wl_get_snapshot_peb(struct ubi_device *ubi, int max_pnum)
+{
+	struct rb_node *rb;
+	struct ubi_wl_entry *e;
+
+	spin_lock(&ubi->wl_lock);
+	ubi_rb_for_each_entry(rb, e, &ubi->free, u.rb)
+		if (e->pnum < max_pnum)
+			break;
+
+	if (!e) {
+		spin_unlock(&ubi->wl_lock);
+		return -ENOSPC;
+	}
+
+	paranoid_check_in_wl_tree(e, &ubi->free);
+	rb_erase(&e->u.rb, &ubi->free);
+	dbg_wl("PEB %d EC %d", e->pnum, e->ec);
+	prot_queue_add(ubi, e);
+	spin_unlock(&ubi->wl_lock);
+
+	return e->pnum;
+}
+#endif
+
 /**
  * prot_queue_del - remove a physical eraseblock from the protection queue.
  * @ubi: UBI device description object
@@ -1088,6 +1126,10 @@ static int erase_worker(struct ubi_device *ubi, struct ubi_work *wl_wrk,
 	if (err)
 		goto out_ro;
 
+	spin_lock(&ubi->wl_lock);
+	ubi->lookuptbl[pnum] = NULL;
+	spin_unlock(&ubi->wl_lock);
+
 	spin_lock(&ubi->volumes_lock);
 	ubi->beb_rsvd_pebs -= 1;
 	ubi->bad_peb_count += 1;
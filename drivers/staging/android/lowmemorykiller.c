@@ -32,6 +32,7 @@
 #include <linux/module.h>
 #include <linux/kernel.h>
 #include <linux/mm.h>
+#include <linux/memcontrol.h>
 #include <linux/oom.h>
 #include <linux/sched.h>
 #include <linux/notifier.h>
@@ -151,6 +152,11 @@ static int lowmem_shrink(struct shrinker *s, int nr_to_scan, gfp_t gfp_mask)
 		}
 		tasksize = get_mm_rss(mm);
 		task_unlock(p);
+		/*
+		 * When an app runs alone in its own memory cgroup, the cgroup
+		 * also accounts its ashmem and shmem, which rss misses.
+		 */
+		tasksize = max_t(int, tasksize, mem_cgroup_task_pages(p));
 		if (tasksize <= 0)
 			continue;
 		if (selected) {
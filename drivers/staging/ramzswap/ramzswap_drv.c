@@ -23,8 +23,10 @@
 #include <linux/device.h>
 #include <linux/genhd.h>
 #include <linux/highmem.h>
+#include <linux/jhash.h>
+#include <linux/log2.h>
 #include <linux/slab.h>
-#include <linux/lzo.h>
+#include <linux/hrtimer.h>
 #include <linux/string.h>
 #include <linux/swap.h>
 #include <linux/swapops.h>
@@ -39,6 +41,9 @@ static struct ramzswap *devices;
 /* Module params (documentation at end) */
 static unsigned int num_devices;
 
+/* Algorithms compared in benchmark mode */
+static const char * const rzs_bench_algs[RZS_NR_BENCH] = { "lzo", "deflate" };
+
 static int rzs_test_flag(struct ramzswap *rzs, u32 index,
 			enum rzs_pageflags flag)
 {
@@ -57,18 +62,23 @@ static void rzs_clear_flag(struct ramzswap *rzs, u32 index,
 	rzs->table[index].flags &= ~BIT(flag);
 }
 
-static int page_zero_filled(void *ptr)
+/*
+ * Check if the page is filled with a single repeated word, which is
+ * returned in @element. All-zero pages are the most common case.
+ */
+static int page_same_filled(void *ptr, unsigned long *element)
 {
 	unsigned int pos;
 	unsigned long *page;
 
 	page = (unsigned long *)ptr;
 
-	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
-		if (page[pos])
+	for (pos = 1; pos != PAGE_SIZE / sizeof(*page); pos++) {
+		if (page[pos] != page[0])
 			return 0;
 	}
 
+	*element = page[0];
 	return 1;
 }
 
@@ -158,88 +168,149 @@ static void ramzswap_ioctl_get_stats(struct ramzswap *rzs,
 #endif /* CONFIG_RAMZSWAP_STATS */
 }
 
+static void ramzswap_ioctl_get_stats_ext(struct ramzswap *rzs,
+			struct ramzswap_ioctl_stats_ext *s)
+{
+#if defined(CONFIG_RAMZSWAP_STATS)
+	struct ramzswap_stats *rs = &rzs->stats;
+	u64 pool_size, pool_used;
+
+	pool_size = xv_get_total_size_bytes(rzs->mem_pool);
+	pool_used = xv_get_used_size_bytes(rzs->mem_pool);
+
+	s->pages_pattern = rs->pages_pattern;
+	s->pages_dedup = rs->pages_dedup;
+	s->dedup_saved = rs->dedup_size;
+	s->pages_backed = rs->pages_backed;
+	s->bd_reads = rzs_stat64_read(rzs, &rs->bd_reads);
+	s->bd_writes = rzs_stat64_read(rzs, &rs->bd_writes);
+	if (pool_size)
+		s->frag_pct = div64_u64((pool_size - pool_used) * 100,
+					pool_size);
+	s->objs_moved = rzs_stat64_read(rzs, &rs->objs_moved);
+	s->pages_compacted = rzs_stat64_read(rzs, &rs->pages_compacted);
+#endif /* CONFIG_RAMZSWAP_STATS */
+}
+
+/*
+ * Look up an object with the given compressed contents.
+ * Called with the table lock held for writing.
+ */
+static struct rzs_obj *rzs_find_obj(struct ramzswap *rzs, u32 checksum,
+				void *mem, u32 size)
+{
+	int same;
+	void *cmem;
+	struct rzs_obj *obj;
+	struct hlist_node *pos;
+	struct hlist_head *head = &rzs->obj_hash[checksum & rzs->obj_hash_mask];
+
+	hlist_for_each_entry(obj, pos, head, hnode) {
+		if (obj->checksum != checksum || obj->size != size)
+			continue;
+
+		cmem = kmap_atomic(obj->page, KM_USER1) + obj->offset;
+		same = !memcmp(cmem + sizeof(struct zobj_header), mem, size);
+		kunmap_atomic(cmem, KM_USER1);
+		if (same)
+			return obj;
+	}
+
+	return NULL;
+}
+
+/* Called with the table lock held for writing */
+static void rzs_put_obj(struct ramzswap *rzs, struct rzs_obj *obj)
+{
+	if (--obj->refcount) {
+		rzs_stat_dec(&rzs->stats.pages_dedup);
+		rzs->stats.dedup_size -= obj->size;
+		return;
+	}
+
+	hlist_del(&obj->hnode);
+	xv_free(rzs->mem_pool, obj->page, obj->offset);
+	rzs->stats.compr_size -= obj->size;
+	kfree(obj);
+}
+
+/* Called with the table lock held for writing */
 static void ramzswap_free_page(struct ramzswap *rzs, size_t index)
 {
-	u32 clen;
-	void *obj;
+	struct rzs_obj *obj;
 
-	struct page *page = rzs->table[index].page;
-	u32 offset = rzs->table[index].offset;
+	/* Restart aging and abort any writeback in progress */
+	rzs->table[index].count = 0;
+	rzs_clear_flag(rzs, index, RZS_WB);
 
-	if (unlikely(!page)) {
-		/*
-		 * No memory is allocated for zero filled pages.
-		 * Simply clear zero page flag.
-		 */
-		if (rzs_test_flag(rzs, index, RZS_ZERO)) {
-			rzs_clear_flag(rzs, index, RZS_ZERO);
-			rzs_stat_dec(&rzs->stats.pages_zero);
-		}
+	if (rzs_test_flag(rzs, index, RZS_BACKED)) {
+		rzs_clear_flag(rzs, index, RZS_BACKED);
+		__clear_bit(rzs->table[index].bd_slot, rzs->bd_map);
+		rzs->table[index].bd_slot = 0;
+		rzs_stat_dec(&rzs->stats.pages_backed);
+		return;
+	}
+
+	/* No memory is allocated for zero and pattern filled pages */
+	if (rzs_test_flag(rzs, index, RZS_ZERO)) {
+		rzs_clear_flag(rzs, index, RZS_ZERO);
+		rzs_stat_dec(&rzs->stats.pages_zero);
 		return;
 	}
 
+	if (rzs_test_flag(rzs, index, RZS_PATTERN)) {
+		rzs_clear_flag(rzs, index, RZS_PATTERN);
+		rzs_stat_dec(&rzs->stats.pages_pattern);
+		rzs->table[index].element = 0;
+		return;
+	}
+
+	if (unlikely(!rzs->table[index].page))
+		return;
+
 	if (unlikely(rzs_test_flag(rzs, index, RZS_UNCOMPRESSED))) {
-		clen = PAGE_SIZE;
-		__free_page(page);
+		__free_page(rzs->table[index].page);
 		rzs_clear_flag(rzs, index, RZS_UNCOMPRESSED);
 		rzs_stat_dec(&rzs->stats.pages_expand);
+		rzs->stats.compr_size -= PAGE_SIZE;
 		goto out;
 	}
 
-	obj = kmap_atomic(page, KM_USER0) + offset;
-	clen = xv_get_object_size(obj) - sizeof(struct zobj_header);
-	kunmap_atomic(obj, KM_USER0);
-
-	xv_free(rzs->mem_pool, page, offset);
-	if (clen <= PAGE_SIZE / 2)
+	obj = rzs->table[index].obj;
+	if (obj->size <= PAGE_SIZE / 2)
 		rzs_stat_dec(&rzs->stats.good_compress);
+	rzs_put_obj(rzs, obj);
 
 out:
-	rzs->stats.compr_size -= clen;
 	rzs_stat_dec(&rzs->stats.pages_stored);
-
 	rzs->table[index].page = NULL;
-	rzs->table[index].offset = 0;
 }
 
-static int handle_zero_page(struct bio *bio)
+static void handle_same_filled_page(struct page *page, unsigned long element)
 {
-	void *user_mem;
-	struct page *page = bio->bi_io_vec[0].bv_page;
+	unsigned int pos;
+	unsigned long *user_mem;
 
 	user_mem = kmap_atomic(page, KM_USER0);
-	memset(user_mem, 0, PAGE_SIZE);
+	if (!element)
+		memset(user_mem, 0, PAGE_SIZE);
+	else
+		for (pos = 0; pos != PAGE_SIZE / sizeof(*user_mem); pos++)
+			user_mem[pos] = element;
 	kunmap_atomic(user_mem, KM_USER0);
-
-	flush_dcache_page(page);
-
-	set_bit(BIO_UPTODATE, &bio->bi_flags);
-	bio_endio(bio, 0);
-	return 0;
 }
 
-static int handle_uncompressed_page(struct ramzswap *rzs, struct bio *bio)
+static void handle_uncompressed_page(struct ramzswap *rzs, struct page *page,
+				u32 index)
 {
-	u32 index;
-	struct page *page;
 	unsigned char *user_mem, *cmem;
 
-	page = bio->bi_io_vec[0].bv_page;
-	index = bio->bi_sector >> SECTORS_PER_PAGE_SHIFT;
-
 	user_mem = kmap_atomic(page, KM_USER0);
-	cmem = kmap_atomic(rzs->table[index].page, KM_USER1) +
-			rzs->table[index].offset;
+	cmem = kmap_atomic(rzs->table[index].page, KM_USER1);
 
 	memcpy(user_mem, cmem, PAGE_SIZE);
 	kunmap_atomic(user_mem, KM_USER0);
 	kunmap_atomic(cmem, KM_USER1);
-
-	flush_dcache_page(page);
-
-	set_bit(BIO_UPTODATE, &bio->bi_flags);
-	bio_endio(bio, 0);
-	return 0;
 }
 
 /*
@@ -248,7 +319,7 @@ static int handle_uncompressed_page(struct ramzswap *rzs, struct bio *bio)
  * to this location - this happens due to readahead when
  * swap device is read from user-space (e.g. during swapon)
  */
-static int handle_ramzswap_fault(struct ramzswap *rzs, struct bio *bio)
+static void handle_ramzswap_fault(struct ramzswap *rzs, struct bio *bio)
 {
 	pr_debug("Read before write on swap device: "
 		"sector=%lu, size=%u, offset=%u\n",
@@ -256,43 +327,36 @@ static int handle_ramzswap_fault(struct ramzswap *rzs, struct bio *bio)
 		bio->bi_io_vec[0].bv_offset);
 
 	/* Do nothing. Just return success */
-	set_bit(BIO_UPTODATE, &bio->bi_flags);
-	bio_endio(bio, 0);
-	return 0;
 }
 
-static int ramzswap_read(struct ramzswap *rzs, struct bio *bio)
+/*
+ * Copy out a page held in memory, either uncompressed or compressed.
+ * Called with the table lock held.
+ */
+static int rzs_read_stored(struct ramzswap *rzs, u32 index, struct page *page)
 {
 	int ret;
-	u32 index;
-	size_t clen;
-	struct page *page;
+	unsigned int clen;
+	struct rzs_obj *obj;
+	struct rzs_cstream *cs;
 	struct zobj_header *zheader;
 	unsigned char *user_mem, *cmem;
 
-	rzs_stat64_inc(rzs, &rzs->stats.num_reads);
-
-	page = bio->bi_io_vec[0].bv_page;
-	index = bio->bi_sector >> SECTORS_PER_PAGE_SHIFT;
-
-	if (rzs_test_flag(rzs, index, RZS_ZERO))
-		return handle_zero_page(bio);
-
-	/* Requested page is not present in compressed area */
-	if (!rzs->table[index].page)
-		return handle_ramzswap_fault(rzs, bio);
-
 	/* Page is stored uncompressed since it's incompressible */
-	if (unlikely(rzs_test_flag(rzs, index, RZS_UNCOMPRESSED)))
-		return handle_uncompressed_page(rzs, bio);
+	if (unlikely(rzs_test_flag(rzs, index, RZS_UNCOMPRESSED))) {
+		handle_uncompressed_page(rzs, page, index);
+		return 0;
+	}
 
 	user_mem = kmap_atomic(page, KM_USER0);
 	clen = PAGE_SIZE;
 
-	cmem = kmap_atomic(rzs->table[index].page, KM_USER1) +
-			rzs->table[index].offset;
+	obj = rzs->table[index].obj;
+	cmem = kmap_atomic(obj->page, KM_USER1) + obj->offset;
 
-	ret = lzo1x_decompress_safe(
+	/* Preemption is disabled by the table lock */
+	cs = per_cpu_ptr(rzs->cstreams, smp_processor_id());
+	ret = crypto_comp_decompress(cs->dtfm,
 		cmem + sizeof(*zheader),
 		xv_get_object_size(cmem) - sizeof(*zheader),
 		user_mem, &clen);
@@ -300,16 +364,101 @@ static int ramzswap_read(struct ramzswap *rzs, struct bio *bio)
 	kunmap_atomic(user_mem, KM_USER0);
 	kunmap_atomic(cmem, KM_USER1);
 
+	if (!ret && clen != PAGE_SIZE)
+		ret = -EINVAL;
+
+	return ret;
+}
+
+static void rzs_backing_read_endio(struct bio *bio, int err)
+{
+	struct bio *orig = bio->bi_private;
+
+	if (!err)
+		set_bit(BIO_UPTODATE, &orig->bi_flags);
+	bio_endio(orig, err);
+	bio_put(bio);
+}
+
+/*
+ * The page was written out to the backing device. Read it straight
+ * into the page of the original bio which is completed from our
+ * end_io. The slot cannot be freed while the swap-in is in progress.
+ */
+static void ramzswap_read_backing(struct ramzswap *rzs, struct bio *bio,
+				unsigned long slot)
+{
+	struct bio *rbio;
+
+	rbio = bio_alloc(GFP_NOIO, 1);
+	rbio->bi_bdev = rzs->backing_bdev;
+	rbio->bi_sector = slot << SECTORS_PER_PAGE_SHIFT;
+	rbio->bi_end_io = rzs_backing_read_endio;
+	rbio->bi_private = bio;
+	bio_add_page(rbio, bio->bi_io_vec[0].bv_page, PAGE_SIZE, 0);
+
+	rzs_stat64_inc(rzs, &rzs->stats.bd_reads);
+	submit_bio(READ_SYNC, rbio);
+}
+
+/*
+ * Reads only need the table lock for reading, so they may run
+ * concurrently with each other. The lock keeps the object from being
+ * freed under us by a write or a slot free notification.
+ */
+static int ramzswap_read(struct ramzswap *rzs, struct bio *bio)
+{
+	int ret;
+	u32 index;
+	unsigned long slot;
+	struct page *page;
+
+	rzs_stat64_inc(rzs, &rzs->stats.num_reads);
+
+	page = bio->bi_io_vec[0].bv_page;
+	index = bio->bi_sector >> SECTORS_PER_PAGE_SHIFT;
+
+	read_lock(&rzs->table_lock);
+
+	if (rzs_test_flag(rzs, index, RZS_ZERO)) {
+		handle_same_filled_page(page, 0);
+		goto out_done;
+	}
+
+	if (rzs_test_flag(rzs, index, RZS_PATTERN)) {
+		handle_same_filled_page(page, rzs->table[index].element);
+		goto out_done;
+	}
+
+	if (rzs_test_flag(rzs, index, RZS_BACKED)) {
+		slot = rzs->table[index].bd_slot;
+		read_unlock(&rzs->table_lock);
+		ramzswap_read_backing(rzs, bio, slot);
+		return 0;
+	}
+
+	/* Requested page is not present in compressed area */
+	if (!rzs->table[index].page) {
+		read_unlock(&rzs->table_lock);
+		handle_ramzswap_fault(rzs, bio);
+		goto out_endio;
+	}
+
+	ret = rzs_read_stored(rzs, index, page);
+
 	/* should NEVER happen */
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
+		read_unlock(&rzs->table_lock);
 		pr_err("Decompression failed! err=%d, page=%u\n",
 			ret, index);
 		rzs_stat64_inc(rzs, &rzs->stats.failed_reads);
 		goto out;
 	}
 
+out_done:
+	read_unlock(&rzs->table_lock);
 	flush_dcache_page(page);
-
+out_endio:
 	set_bit(BIO_UPTODATE, &bio->bi_flags);
 	bio_endio(bio, 0);
 	return 0;
@@ -319,13 +468,91 @@ out:
 	return 0;
 }
 
+/*
+ * Get the compression stream of the current CPU. The caller may sleep
+ * while holding the stream, so it is protected by a mutex rather than
+ * by disabling preemption.
+ */
+static struct rzs_cstream *rzs_get_cstream(struct ramzswap *rzs)
+{
+	struct rzs_cstream *cs;
+
+	cs = per_cpu_ptr(rzs->cstreams, get_cpu());
+	put_cpu();
+
+	mutex_lock(&cs->lock);
+	return cs;
+}
+
+static void rzs_put_cstream(struct rzs_cstream *cs)
+{
+	mutex_unlock(&cs->lock);
+}
+
+/*
+ * Benchmark mode: compress the page with each of rzs_bench_algs and
+ * decompress it again, accounting the sizes and times.
+ * Called with the compression stream held.
+ */
+static void rzs_bench_page(struct ramzswap *rzs, struct rzs_cstream *cs,
+			struct page *page)
+{
+	int i, ret;
+	unsigned int clen, dlen;
+	ktime_t start, mid, end;
+	unsigned char *user_mem;
+	struct rzs_bench_stats *b;
+
+	if (atomic_inc_return(&rzs->bench_count) % rzs->bench_interval)
+		return;
+
+	for (i = 0; i < RZS_NR_BENCH; i++) {
+		if (!cs->bench_tfm[i])
+			continue;
+
+		clen = 2 * PAGE_SIZE;
+		dlen = PAGE_SIZE;
+
+		user_mem = kmap_atomic(page, KM_USER0);
+		start = ktime_get();
+		ret = crypto_comp_compress(cs->bench_tfm[i], user_mem,
+				PAGE_SIZE, cs->bench_buffer, &clen);
+		mid = ktime_get();
+		kunmap_atomic(user_mem, KM_USER0);
+		if (ret)
+			continue;
+
+		ret = crypto_comp_decompress(cs->bench_tfm[i],
+				cs->bench_buffer, clen, cs->bench_page, &dlen);
+		end = ktime_get();
+		if (ret || dlen != PAGE_SIZE)
+			continue;
+
+		b = &rzs->bench[i];
+		spin_lock(&rzs->stat64_lock);
+		b->samples++;
+		b->orig_bytes += PAGE_SIZE;
+		b->compr_bytes += clen;
+		b->compr_ns += ktime_to_ns(ktime_sub(mid, start));
+		b->decompr_ns += ktime_to_ns(ktime_sub(end, mid));
+		spin_unlock(&rzs->stat64_lock);
+	}
+}
+
+/*
+ * Compression and memory allocation are done without the table lock,
+ * only installing the new object in the table is serialized.
+ */
 static int ramzswap_write(struct ramzswap *rzs, struct bio *bio)
 {
 	int ret;
-	u32 offset, index;
-	size_t clen;
+	u32 offset, index, checksum;
+	unsigned int clen;
+	unsigned long element;
 	struct zobj_header *zheader;
 	struct page *page, *page_store;
+	struct rzs_cstream *cs;
+	struct rzs_obj *obj;
 	unsigned char *user_mem, *cmem, *src;
 
 	rzs_stat64_inc(rzs, &rzs->stats.num_writes);
@@ -333,29 +560,42 @@ static int ramzswap_write(struct ramzswap *rzs, struct bio *bio)
 	page = bio->bi_io_vec[0].bv_page;
 	index = bio->bi_sector >> SECTORS_PER_PAGE_SHIFT;
 
-	src = rzs->compress_buffer;
-
-	mutex_lock(&rzs->lock);
-
 	user_mem = kmap_atomic(page, KM_USER0);
-	if (page_zero_filled(user_mem)) {
+	if (page_same_filled(user_mem, &element)) {
 		kunmap_atomic(user_mem, KM_USER0);
-		mutex_unlock(&rzs->lock);
-		rzs_stat_inc(&rzs->stats.pages_zero);
-		rzs_set_flag(rzs, index, RZS_ZERO);
+
+		write_lock(&rzs->table_lock);
+		ramzswap_free_page(rzs, index);
+		if (!element) {
+			rzs_stat_inc(&rzs->stats.pages_zero);
+			rzs_set_flag(rzs, index, RZS_ZERO);
+		} else {
+			rzs_stat_inc(&rzs->stats.pages_pattern);
+			rzs_set_flag(rzs, index, RZS_PATTERN);
+			rzs->table[index].element = element;
+		}
+		write_unlock(&rzs->table_lock);
 
 		set_bit(BIO_UPTODATE, &bio->bi_flags);
 		bio_endio(bio, 0);
 		return 0;
 	}
+	kunmap_atomic(user_mem, KM_USER0);
 
-	ret = lzo1x_1_compress(user_mem, PAGE_SIZE, src, &clen,
-				rzs->compress_workmem);
+	cs = rzs_get_cstream(rzs);
+
+	clen = 2 * PAGE_SIZE;
+	user_mem = kmap_atomic(page, KM_USER0);
+	ret = crypto_comp_compress(cs->tfm, user_mem, PAGE_SIZE, cs->buffer,
+				&clen);
 
 	kunmap_atomic(user_mem, KM_USER0);
 
-	if (unlikely(ret != LZO_E_OK)) {
-		mutex_unlock(&rzs->lock);
+	if (rzs->bench_interval)
+		rzs_bench_page(rzs, cs, page);
+
+	if (unlikely(ret)) {
+		rzs_put_cstream(cs);
 		pr_err("Compression failed! err=%d\n", ret);
 		rzs_stat64_inc(rzs, &rzs->stats.failed_writes);
 		goto out;
@@ -367,63 +607,100 @@ static int ramzswap_write(struct ramzswap *rzs, struct bio *bio)
 	 * errors which has side effect of hanging the system.
 	 */
 	if (unlikely(clen > max_zpage_size)) {
-		clen = PAGE_SIZE;
+		rzs_put_cstream(cs);
 		page_store = alloc_page(GFP_NOIO | __GFP_HIGHMEM);
 		if (unlikely(!page_store)) {
-			mutex_unlock(&rzs->lock);
 			pr_info("Error allocating memory for incompressible "
 				"page: %u\n", index);
 			rzs_stat64_inc(rzs, &rzs->stats.failed_writes);
 			goto out;
 		}
 
-		offset = 0;
+		src = kmap_atomic(page, KM_USER0);
+		cmem = kmap_atomic(page_store, KM_USER1);
+		memcpy(cmem, src, PAGE_SIZE);
+		kunmap_atomic(cmem, KM_USER1);
+		kunmap_atomic(src, KM_USER0);
+
+		write_lock(&rzs->table_lock);
+		ramzswap_free_page(rzs, index);
+		rzs->table[index].page = page_store;
 		rzs_set_flag(rzs, index, RZS_UNCOMPRESSED);
 		rzs_stat_inc(&rzs->stats.pages_expand);
-		rzs->table[index].page = page_store;
-		src = kmap_atomic(page, KM_USER0);
-		goto memstore;
+		rzs->stats.compr_size += PAGE_SIZE;
+		rzs_stat_inc(&rzs->stats.pages_stored);
+		write_unlock(&rzs->table_lock);
+		goto out_done;
 	}
 
+	/* Share the object if identical data is already stored */
+	checksum = jhash(cs->buffer, clen, 0);
+	write_lock(&rzs->table_lock);
+	obj = rzs_find_obj(rzs, checksum, cs->buffer, clen);
+	if (obj) {
+		/* Take the reference first, @index may use @obj already */
+		obj->refcount++;
+		rzs_stat_inc(&rzs->stats.pages_dedup);
+		rzs->stats.dedup_size += clen;
+		goto install;
+	}
+	write_unlock(&rzs->table_lock);
+
+	obj = kmalloc(sizeof(*obj), GFP_NOIO);
+	if (unlikely(!obj)) {
+		rzs_put_cstream(cs);
+		rzs_stat64_inc(rzs, &rzs->stats.failed_writes);
+		goto out;
+	}
+
+	down_read(&rzs->compact_sem);
 	if (xv_malloc(rzs->mem_pool, clen + sizeof(*zheader),
-			&rzs->table[index].page, &offset,
-			GFP_NOIO | __GFP_HIGHMEM)) {
-		mutex_unlock(&rzs->lock);
+			&page_store, &offset, GFP_NOIO | __GFP_HIGHMEM)) {
+		up_read(&rzs->compact_sem);
+		rzs_put_cstream(cs);
+		kfree(obj);
 		pr_info("Error allocating memory for compressed "
-			"page: %u, size=%zu\n", index, clen);
+			"page: %u, size=%u\n", index, clen);
 		rzs_stat64_inc(rzs, &rzs->stats.failed_writes);
 		goto out;
 	}
 
-memstore:
-	rzs->table[index].offset = offset;
-
-	cmem = kmap_atomic(rzs->table[index].page, KM_USER1) +
-			rzs->table[index].offset;
+	cmem = kmap_atomic(page_store, KM_USER1) + offset;
 
-#if 0
 	/* Back-reference needed for memory defragmentation */
-	if (!rzs_test_flag(rzs, index, RZS_UNCOMPRESSED)) {
-		zheader = (struct zobj_header *)cmem;
-		zheader->table_idx = index;
-		cmem += sizeof(*zheader);
-	}
-#endif
+	zheader = (struct zobj_header *)cmem;
+	zheader->obj = obj;
+	cmem += sizeof(*zheader);
 
-	memcpy(cmem, src, clen);
+	memcpy(cmem, cs->buffer, clen);
 
 	kunmap_atomic(cmem, KM_USER1);
-	if (unlikely(rzs_test_flag(rzs, index, RZS_UNCOMPRESSED)))
-		kunmap_atomic(src, KM_USER0);
 
-	/* Update stats */
+	obj->checksum = checksum;
+	obj->refcount = 1;
+	obj->page = page_store;
+	obj->offset = offset;
+	obj->size = clen;
+
+	write_lock(&rzs->table_lock);
+	hlist_add_head(&obj->hnode,
+		       &rzs->obj_hash[checksum & rzs->obj_hash_mask]);
 	rzs->stats.compr_size += clen;
+	up_read(&rzs->compact_sem);
+
+install:
+	/* Free the stale copy, if any, before installing the new one */
+	ramzswap_free_page(rzs, index);
+	rzs->table[index].obj = obj;
+
 	rzs_stat_inc(&rzs->stats.pages_stored);
 	if (clen <= PAGE_SIZE / 2)
 		rzs_stat_inc(&rzs->stats.good_compress);
 
-	mutex_unlock(&rzs->lock);
+	write_unlock(&rzs->table_lock);
+	rzs_put_cstream(cs);
 
+out_done:
 	set_bit(BIO_UPTODATE, &bio->bi_flags);
 	bio_endio(bio, 0);
 	return 0;
@@ -484,47 +761,470 @@ static int ramzswap_make_request(struct request_queue *queue, struct bio *bio)
 	return ret;
 }
 
+/* A batch of pages being written to the backing device */
+struct rzs_wb_batch {
+	atomic_t pending;		/* bios in flight + 1 */
+	struct completion done;
+	int error;
+	int count;
+	u32 index[RZS_WB_BATCH];	/* 0 if the page was not copied */
+	unsigned long slot[RZS_WB_BATCH];
+	struct page *page[RZS_WB_BATCH];
+};
+
+/* Called with the table lock held for writing */
+static int rzs_alloc_bd_slot(struct ramzswap *rzs, unsigned long *slot)
+{
+	unsigned long bit;
+
+	bit = find_next_zero_bit(rzs->bd_map, rzs->bd_pages, rzs->bd_cursor);
+	if (bit >= rzs->bd_pages) {
+		bit = find_first_zero_bit(rzs->bd_map, rzs->bd_pages);
+		if (bit >= rzs->bd_pages)
+			return -ENOSPC;
+	}
+
+	__set_bit(bit, rzs->bd_map);
+	rzs->bd_cursor = bit + 1;
+	*slot = bit;
+
+	return 0;
+}
+
+/*
+ * Incompressible pages are always written back, compressed ones only
+ * if they have not been rewritten for @min_age writeback passes. Pages
+ * which are kept get one pass older.
+ *
+ * Called with the table lock held for writing.
+ */
+static int rzs_wb_eligible(struct ramzswap *rzs, u32 index, u32 min_age)
+{
+	struct table *t = &rzs->table[index];
+
+	if (t->flags & (BIT(RZS_ZERO) | BIT(RZS_PATTERN) | BIT(RZS_BACKED)))
+		return 0;
+
+	if (!t->page)
+		return 0;
+
+	if (rzs_test_flag(rzs, index, RZS_UNCOMPRESSED) || t->count >= min_age)
+		return 1;
+
+	if (t->count < (u8)~0)
+		t->count++;
+
+	return 0;
+}
+
+static void rzs_wb_endio(struct bio *bio, int err)
+{
+	struct rzs_wb_batch *wb = bio->bi_private;
+
+	if (err)
+		wb->error = err;
+	if (atomic_dec_and_test(&wb->pending))
+		complete(&wb->done);
+	bio_put(bio);
+}
+
+/*
+ * Write out the batch and wait for it. Pages going to adjacent slots
+ * are merged into a single bio as far as the backing queue allows.
+ */
+static int rzs_wb_submit(struct ramzswap *rzs, struct rzs_wb_batch *wb)
+{
+	int i;
+	struct bio *bio = NULL;
+
+	atomic_set(&wb->pending, 1);
+	init_completion(&wb->done);
+	wb->error = 0;
+
+	for (i = 0; i < wb->count; i++) {
+		if (bio && wb->slot[i] == wb->slot[i - 1] + 1 &&
+		    bio_add_page(bio, wb->page[i], PAGE_SIZE, 0) == PAGE_SIZE)
+			continue;
+
+		if (bio) {
+			atomic_inc(&wb->pending);
+			submit_bio(WRITE, bio);
+		}
+
+		bio = bio_alloc(GFP_NOIO, wb->count - i);
+		bio->bi_bdev = rzs->backing_bdev;
+		bio->bi_sector = wb->slot[i] << SECTORS_PER_PAGE_SHIFT;
+		bio->bi_end_io = rzs_wb_endio;
+		bio->bi_private = wb;
+		bio_add_page(bio, wb->page[i], PAGE_SIZE, 0);
+	}
+
+	if (bio) {
+		atomic_inc(&wb->pending);
+		submit_bio(WRITE, bio);
+	}
+
+	blk_unplug(bdev_get_queue(rzs->backing_bdev));
+
+	if (!atomic_dec_and_test(&wb->pending))
+		wait_for_completion(&wb->done);
+
+	return wb->error;
+}
+
+/*
+ * Move idle and incompressible pages to the backing device, freeing
+ * the memory they use. Each call is one aging pass over the table.
+ *
+ * Pages are marked RZS_WB while being written. A write or free of the
+ * slot in the meantime clears the mark and the page is kept in memory.
+ */
+static int ramzswap_writeback(struct ramzswap *rzs, u32 min_age)
+{
+	int i, ret = 0;
+	u32 index, num_pages;
+	struct rzs_wb_batch *wb;
+
+	wb = kzalloc(sizeof(*wb), GFP_KERNEL);
+	if (!wb)
+		return -ENOMEM;
+
+	for (i = 0; i < RZS_WB_BATCH; i++) {
+		wb->page[i] = alloc_page(GFP_NOIO);
+		if (!wb->page[i]) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	mutex_lock(&rzs->wb_lock);
+	if (!rzs->init_done || !rzs->backing_bdev) {
+		ret = -EINVAL;
+		goto out_unlock;
+	}
+
+	num_pages = rzs->disksize >> PAGE_SHIFT;
+
+	/* Page 0 holds the swap header and stays in memory */
+	index = 1;
+	while (index < num_pages && !ret) {
+		wb->count = 0;
+
+		write_lock(&rzs->table_lock);
+		for (; index < num_pages && wb->count < RZS_WB_BATCH; index++) {
+			if (!rzs_wb_eligible(rzs, index, min_age))
+				continue;
+			if (rzs_alloc_bd_slot(rzs, &wb->slot[wb->count])) {
+				/* Backing device is full */
+				index = num_pages;
+				break;
+			}
+			rzs_set_flag(rzs, index, RZS_WB);
+			wb->index[wb->count++] = index;
+		}
+		write_unlock(&rzs->table_lock);
+
+		if (!wb->count)
+			break;
+
+		read_lock(&rzs->table_lock);
+		for (i = 0; i < wb->count; i++) {
+			if (!rzs_test_flag(rzs, wb->index[i], RZS_WB) ||
+			    rzs_read_stored(rzs, wb->index[i], wb->page[i]))
+				wb->index[i] = 0;
+		}
+		read_unlock(&rzs->table_lock);
+
+		ret = rzs_wb_submit(rzs, wb);
+		if (ret)
+			pr_err("Writeback to backing device failed: "
+				"err=%d\n", ret);
+
+		write_lock(&rzs->table_lock);
+		for (i = 0; i < wb->count; i++) {
+			u32 idx = wb->index[i];
+
+			if (!ret && idx && rzs_test_flag(rzs, idx, RZS_WB)) {
+				ramzswap_free_page(rzs, idx);
+				rzs->table[idx].bd_slot = wb->slot[i];
+				rzs_set_flag(rzs, idx, RZS_BACKED);
+				rzs_stat_inc(&rzs->stats.pages_backed);
+				rzs_stat64_inc(rzs, &rzs->stats.bd_writes);
+				continue;
+			}
+
+			/* Freed or rewritten meanwhile, or I/O failed */
+			if (idx)
+				rzs_clear_flag(rzs, idx, RZS_WB);
+			__clear_bit(wb->slot[i], rzs->bd_map);
+		}
+		write_unlock(&rzs->table_lock);
+	}
+
+out_unlock:
+	mutex_unlock(&rzs->wb_lock);
+out:
+	for (i = 0; i < RZS_WB_BATCH; i++)
+		if (wb->page[i])
+			__free_page(wb->page[i]);
+	kfree(wb);
+
+	return ret;
+}
+
+/* Called by xv_compact() with the table lock held for writing */
+static void rzs_move_obj(void *cmem, struct page *page, u32 offset,
+			void *arg)
+{
+	struct ramzswap *rzs = arg;
+	struct zobj_header *zheader = cmem;
+
+	zheader->obj->page = page;
+	zheader->obj->offset = offset;
+	rzs_stat64_inc(rzs, &rzs->stats.objs_moved);
+}
+
+/*
+ * Move objects out of sparsely used pool pages. At most @nr_pages pages
+ * are scanned, RZS_COMPACT_BATCH at a time so that reads are not held
+ * off for long. Called with compact_sem held for writing.
+ */
+static void ramzswap_compact(struct ramzswap *rzs, u32 nr_pages)
+{
+	u32 batch, freed = 0;
+
+	while (nr_pages) {
+		batch = min_t(u32, nr_pages, RZS_COMPACT_BATCH);
+		nr_pages -= batch;
+
+		write_lock(&rzs->table_lock);
+		freed += xv_compact(rzs->mem_pool, batch, rzs_move_obj, rzs);
+		write_unlock(&rzs->table_lock);
+
+		cond_resched();
+	}
+
+	rzs_stat64_add(rzs, &rzs->stats.pages_compacted, freed);
+}
+
+/* Pool pages that could be freed if there was no fragmentation */
+static int rzs_compactable_pages(struct ramzswap *rzs)
+{
+	u64 size, used;
+
+	size = xv_get_total_size_bytes(rzs->mem_pool) >> PAGE_SHIFT;
+	used = (xv_get_used_size_bytes(rzs->mem_pool) + PAGE_SIZE - 1)
+			>> PAGE_SHIFT;
+
+	return size > used ? size - used : 0;
+}
+
+/*
+ * Compact on memory pressure. A writer may hold compact_sem while in
+ * reclaim itself, so never wait for it.
+ */
+static int ramzswap_shrink(struct shrinker *shrinker, int nr_to_scan,
+			gfp_t gfp_mask)
+{
+	int ret;
+	struct ramzswap *rzs = container_of(shrinker, struct ramzswap,
+						shrinker);
+
+	if (!down_write_trylock(&rzs->compact_sem))
+		return nr_to_scan ? -1 : 0;
+
+	if (nr_to_scan)
+		ramzswap_compact(rzs, nr_to_scan);
+	ret = rzs_compactable_pages(rzs);
+
+	up_write(&rzs->compact_sem);
+
+	return ret;
+}
+
+static void free_cstreams(struct ramzswap *rzs)
+{
+	int cpu, i;
+
+	if (!rzs->cstreams)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct rzs_cstream *cs = per_cpu_ptr(rzs->cstreams, cpu);
+
+		if (cs->tfm)
+			crypto_free_comp(cs->tfm);
+		if (cs->dtfm)
+			crypto_free_comp(cs->dtfm);
+		free_pages((unsigned long)cs->buffer, 1);
+
+		for (i = 0; i < RZS_NR_BENCH; i++)
+			if (cs->bench_tfm[i])
+				crypto_free_comp(cs->bench_tfm[i]);
+		free_pages((unsigned long)cs->bench_buffer, 1);
+		free_page((unsigned long)cs->bench_page);
+	}
+
+	free_percpu(rzs->cstreams);
+	rzs->cstreams = NULL;
+}
+
+static struct crypto_comp *rzs_alloc_tfm(const char *name)
+{
+	struct crypto_comp *tfm;
+
+	tfm = crypto_alloc_comp(name, 0, 0);
+	return IS_ERR(tfm) ? NULL : tfm;
+}
+
+static int alloc_cstreams(struct ramzswap *rzs)
+{
+	int cpu, i;
+
+	rzs->cstreams = alloc_percpu(struct rzs_cstream);
+	if (!rzs->cstreams)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		struct rzs_cstream *cs = per_cpu_ptr(rzs->cstreams, cpu);
+
+		mutex_init(&cs->lock);
+		cs->tfm = rzs_alloc_tfm(rzs->compressor);
+		cs->dtfm = rzs_alloc_tfm(rzs->compressor);
+		cs->buffer = (void *)__get_free_pages(__GFP_ZERO, 1);
+		if (!cs->tfm || !cs->dtfm || !cs->buffer)
+			return -ENOMEM;
+
+		if (!rzs->bench_interval)
+			continue;
+
+		/* Algorithms not available are skipped */
+		for (i = 0; i < RZS_NR_BENCH; i++)
+			cs->bench_tfm[i] = rzs_alloc_tfm(rzs_bench_algs[i]);
+		cs->bench_buffer = (void *)__get_free_pages(GFP_KERNEL, 1);
+		cs->bench_page = (void *)__get_free_page(GFP_KERNEL);
+		if (!cs->bench_buffer || !cs->bench_page)
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static void ramzswap_ioctl_get_bench(struct ramzswap *rzs,
+			struct ramzswap_ioctl_bench *b)
+{
+	int i;
+
+	strlcpy(b->compressor, rzs->compressor, sizeof(b->compressor));
+
+	spin_lock(&rzs->stat64_lock);
+	for (i = 0; i < RZS_NR_BENCH; i++) {
+		strlcpy(b->alg[i].name, rzs_bench_algs[i],
+			sizeof(b->alg[i].name));
+		b->alg[i].samples = rzs->bench[i].samples;
+		b->alg[i].orig_bytes = rzs->bench[i].orig_bytes;
+		b->alg[i].compr_bytes = rzs->bench[i].compr_bytes;
+		b->alg[i].compr_ns = rzs->bench[i].compr_ns;
+		b->alg[i].decompr_ns = rzs->bench[i].decompr_ns;
+	}
+	spin_unlock(&rzs->stat64_lock);
+}
+
 static void reset_device(struct ramzswap *rzs)
 {
 	size_t index;
 
+	if (rzs->init_done)
+		unregister_shrinker(&rzs->shrinker);
+
 	/* Do not accept any new I/O request */
 	rzs->init_done = 0;
 
 	/* Free various per-device buffers */
-	kfree(rzs->compress_workmem);
-	free_pages((unsigned long)rzs->compress_buffer, 1);
-
-	rzs->compress_workmem = NULL;
-	rzs->compress_buffer = NULL;
+	free_cstreams(rzs);
 
 	/* Free all pages that are still in this ramzswap device */
 	for (index = 0; index < rzs->disksize >> PAGE_SHIFT; index++) {
-		struct page *page;
-		u16 offset;
+		if (rzs_test_flag(rzs, index, RZS_UNCOMPRESSED))
+			__free_page(rzs->table[index].page);
+	}
 
-		page = rzs->table[index].page;
-		offset = rzs->table[index].offset;
+	/* Compressed objects are freed only once, however many users */
+	for (index = 0; rzs->obj_hash && index <= rzs->obj_hash_mask;
+	     index++) {
+		struct rzs_obj *obj;
+		struct hlist_node *pos, *n;
 
-		if (!page)
-			continue;
-
-		if (unlikely(rzs_test_flag(rzs, index, RZS_UNCOMPRESSED)))
-			__free_page(page);
-		else
-			xv_free(rzs->mem_pool, page, offset);
+		hlist_for_each_entry_safe(obj, pos, n, &rzs->obj_hash[index],
+					  hnode) {
+			xv_free(rzs->mem_pool, obj->page, obj->offset);
+			kfree(obj);
+		}
 	}
 
+	vfree(rzs->obj_hash);
+	rzs->obj_hash = NULL;
+
 	vfree(rzs->table);
 	rzs->table = NULL;
 
+	if (rzs->backing_bdev)
+		close_bdev_exclusive(rzs->backing_bdev,
+				FMODE_READ | FMODE_WRITE);
+	rzs->backing_bdev = NULL;
+	rzs->backing_name[0] = '\0';
+
+	vfree(rzs->bd_map);
+	rzs->bd_map = NULL;
+	rzs->bd_pages = 0;
+	rzs->bd_cursor = 0;
+
 	xv_destroy_pool(rzs->mem_pool);
 	rzs->mem_pool = NULL;
 
 	/* Reset stats */
 	memset(&rzs->stats, 0, sizeof(rzs->stats));
+	memset(rzs->bench, 0, sizeof(rzs->bench));
 
 	rzs->disksize = 0;
+	strlcpy(rzs->compressor, default_compressor,
+		sizeof(rzs->compressor));
+	rzs->bench_interval = 0;
+	atomic_set(&rzs->bench_count, 0);
+}
+
+static int setup_backing_bdev(struct ramzswap *rzs)
+{
+	size_t map_size;
+	struct block_device *bdev;
+
+	bdev = open_bdev_exclusive(rzs->backing_name,
+				FMODE_READ | FMODE_WRITE, rzs);
+	if (IS_ERR(bdev)) {
+		pr_err("Error opening backing device: %s\n",
+			rzs->backing_name);
+		return PTR_ERR(bdev);
+	}
+	rzs->backing_bdev = bdev;
+
+	rzs->bd_pages = i_size_read(bdev->bd_inode) >> PAGE_SHIFT;
+	if (!rzs->bd_pages) {
+		pr_err("Backing device %s is empty\n", rzs->backing_name);
+		return -EINVAL;
+	}
+
+	map_size = BITS_TO_LONGS(rzs->bd_pages) * sizeof(long);
+	rzs->bd_map = vmalloc(map_size);
+	if (!rzs->bd_map) {
+		pr_err("Error allocating backing device slot map\n");
+		return -ENOMEM;
+	}
+	memset(rzs->bd_map, 0, map_size);
+
+	pr_info("Using backing device %s (%lu pages)\n",
+		rzs->backing_name, rzs->bd_pages);
+
+	return 0;
 }
 
 static int ramzswap_ioctl_init_device(struct ramzswap *rzs)
@@ -541,17 +1241,10 @@ static int ramzswap_ioctl_init_device(struct ramzswap *rzs)
 
 	ramzswap_set_disksize(rzs, totalram_pages << PAGE_SHIFT);
 
-	rzs->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
-	if (!rzs->compress_workmem) {
-		pr_err("Error allocating compressor working memory!\n");
-		ret = -ENOMEM;
-		goto fail;
-	}
-
-	rzs->compress_buffer = (void *)__get_free_pages(__GFP_ZERO, 1);
-	if (!rzs->compress_buffer) {
-		pr_err("Error allocating compressor buffer space\n");
-		ret = -ENOMEM;
+	ret = alloc_cstreams(rzs);
+	if (ret) {
+		pr_err("Error allocating compression streams for %s\n",
+			rzs->compressor);
 		goto fail;
 	}
 
@@ -566,6 +1259,25 @@ static int ramzswap_ioctl_init_device(struct ramzswap *rzs)
 	}
 	memset(rzs->table, 0, num_pages * sizeof(*rzs->table));
 
+	/* About one hash bucket per four swap slots */
+	rzs->obj_hash_mask = rounddown_pow_of_two(max_t(size_t,
+					num_pages / 4, 1)) - 1;
+	rzs->obj_hash = vmalloc((rzs->obj_hash_mask + 1) *
+				sizeof(*rzs->obj_hash));
+	if (!rzs->obj_hash) {
+		pr_err("Error allocating ramzswap object hash\n");
+		ret = -ENOMEM;
+		goto fail;
+	}
+	memset(rzs->obj_hash, 0, (rzs->obj_hash_mask + 1) *
+				sizeof(*rzs->obj_hash));
+
+	if (rzs->backing_name[0]) {
+		ret = setup_backing_bdev(rzs);
+		if (ret)
+			goto fail;
+	}
+
 	page = alloc_page(__GFP_ZERO);
 	if (!page) {
 		pr_err("Error allocating swap header page\n");
@@ -591,6 +1303,10 @@ static int ramzswap_ioctl_init_device(struct ramzswap *rzs)
 		goto fail;
 	}
 
+	rzs->shrinker.shrink = ramzswap_shrink;
+	rzs->shrinker.seeks = DEFAULT_SEEKS;
+	register_shrinker(&rzs->shrinker);
+
 	rzs->init_done = 1;
 
 	pr_debug("Initialization done!\n");
@@ -605,8 +1321,12 @@ fail:
 
 static int ramzswap_ioctl_reset_device(struct ramzswap *rzs)
 {
+	mutex_lock(&rzs->wb_lock);
+	down_write(&rzs->compact_sem);
 	if (rzs->init_done)
 		reset_device(rzs);
+	up_write(&rzs->compact_sem);
+	mutex_unlock(&rzs->wb_lock);
 
 	return 0;
 }
@@ -615,7 +1335,9 @@ static int ramzswap_ioctl(struct block_device *bdev, fmode_t mode,
 			unsigned int cmd, unsigned long arg)
 {
 	int ret = 0;
+	u32 min_age;
 	size_t disksize_kb;
+	char compressor[RZS_MAX_COMP_NAME];
 
 	struct ramzswap *rzs = bdev->bd_disk->private_data;
 
@@ -634,6 +1356,88 @@ static int ramzswap_ioctl(struct block_device *bdev, fmode_t mode,
 		pr_info("Disk size set to %zu kB\n", disksize_kb);
 		break;
 
+	case RZSIO_SET_COMPRESSOR:
+		if (rzs->init_done) {
+			ret = -EBUSY;
+			goto out;
+		}
+		if (copy_from_user(compressor, (void *)arg, _IOC_SIZE(cmd))) {
+			ret = -EFAULT;
+			goto out;
+		}
+		compressor[RZS_MAX_COMP_NAME - 1] = '\0';
+		if (!crypto_has_comp(compressor, 0, 0)) {
+			pr_info("Compressor %s not available\n", compressor);
+			ret = -EINVAL;
+			goto out;
+		}
+		strcpy(rzs->compressor, compressor);
+		pr_info("Compressor set to %s\n", rzs->compressor);
+		break;
+
+	case RZSIO_SET_BENCH:
+		if (rzs->init_done) {
+			ret = -EBUSY;
+			goto out;
+		}
+		if (copy_from_user(&rzs->bench_interval, (void *)arg,
+						_IOC_SIZE(cmd))) {
+			ret = -EFAULT;
+			goto out;
+		}
+		break;
+
+	case RZSIO_GET_BENCH:
+	{
+		struct ramzswap_ioctl_bench *bench;
+		if (!rzs->init_done) {
+			ret = -ENOTTY;
+			goto out;
+		}
+		bench = kzalloc(sizeof(*bench), GFP_KERNEL);
+		if (!bench) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		ramzswap_ioctl_get_bench(rzs, bench);
+		if (copy_to_user((void *)arg, bench, sizeof(*bench)))
+			ret = -EFAULT;
+		kfree(bench);
+		break;
+	}
+
+	case RZSIO_SET_BACKING_SWAP:
+		if (rzs->init_done) {
+			ret = -EBUSY;
+			goto out;
+		}
+		if (copy_from_user(&rzs->backing_name, (void *)arg,
+						_IOC_SIZE(cmd))) {
+			ret = -EFAULT;
+			goto out;
+		}
+		rzs->backing_name[MAX_SWAP_NAME_LEN - 1] = '\0';
+		pr_info("Backing device set to %s\n", rzs->backing_name);
+		break;
+
+	case RZSIO_WRITEBACK:
+		if (copy_from_user(&min_age, (void *)arg, _IOC_SIZE(cmd))) {
+			ret = -EFAULT;
+			goto out;
+		}
+		ret = ramzswap_writeback(rzs, min_age);
+		break;
+
+	case RZSIO_COMPACT:
+		down_write(&rzs->compact_sem);
+		if (rzs->init_done)
+			ramzswap_compact(rzs, xv_get_total_size_bytes(
+					rzs->mem_pool) >> PAGE_SHIFT);
+		else
+			ret = -ENOTTY;
+		up_write(&rzs->compact_sem);
+		break;
+
 	case RZSIO_GET_STATS:
 	{
 		struct ramzswap_ioctl_stats *stats;
@@ -655,6 +1459,26 @@ static int ramzswap_ioctl(struct block_device *bdev, fmode_t mode,
 		kfree(stats);
 		break;
 	}
+
+	case RZSIO_GET_STATS_EXT:
+	{
+		struct ramzswap_ioctl_stats_ext *stats;
+		if (!rzs->init_done) {
+			ret = -ENOTTY;
+			goto out;
+		}
+		stats = kzalloc(sizeof(*stats), GFP_KERNEL);
+		if (!stats) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		ramzswap_ioctl_get_stats_ext(rzs, stats);
+		if (copy_to_user((void *)arg, stats, sizeof(*stats)))
+			ret = -EFAULT;
+		kfree(stats);
+		break;
+	}
+
 	case RZSIO_INIT:
 		ret = ramzswap_ioctl_init_device(rzs);
 		break;
@@ -687,7 +1511,9 @@ void ramzswap_slot_free_notify(struct block_device *bdev, unsigned long index)
 	struct ramzswap *rzs;
 
 	rzs = bdev->bd_disk->private_data;
+	write_lock(&rzs->table_lock);
 	ramzswap_free_page(rzs, index);
+	write_unlock(&rzs->table_lock);
 	rzs_stat64_inc(rzs, &rzs->stats.notify_free);
 
 	return;
@@ -703,8 +1529,11 @@ static int create_device(struct ramzswap *rzs, int device_id)
 {
 	int ret = 0;
 
-	mutex_init(&rzs->lock);
+	rwlock_init(&rzs->table_lock);
+	mutex_init(&rzs->wb_lock);
+	init_rwsem(&rzs->compact_sem);
 	spin_lock_init(&rzs->stat64_lock);
+	strlcpy(rzs->compressor, default_compressor, sizeof(rzs->compressor));
 
 	rzs->queue = blk_alloc_queue(GFP_KERNEL);
 	if (!rzs->queue) {
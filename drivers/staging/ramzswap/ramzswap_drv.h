@@ -17,6 +17,11 @@
 
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
+#include <linux/rwsem.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/crypto.h>
+#include <linux/percpu.h>
 
 #include "ramzswap_ioctl.h"
 #include "xvmalloc.h"
@@ -27,16 +32,16 @@
  */
 static const unsigned max_num_devices = 32;
 
+struct rzs_obj;
+
 /*
  * Stored at beginning of each compressed object.
  *
- * It stores back-reference to table entry which points to this
- * object. This is required to support memory defragmentation.
+ * It stores back-reference to the object descriptor which points to
+ * this object. This is required to support memory defragmentation.
  */
 struct zobj_header {
-#if 0
-	u32 table_idx;
-#endif
+	struct rzs_obj *obj;
 };
 
 /*-- Configurable parameters */
@@ -44,6 +49,9 @@ struct zobj_header {
 /* Default ramzswap disk size: 25% of total RAM */
 static const unsigned default_disksize_perc_ram = 25;
 
+/* Default compressor, any crypto API compression algorithm will do */
+static const char *default_compressor = "lzo";
+
 /*
  * Pages that compress to size greater than this are stored
  * uncompressed in memory.
@@ -56,6 +64,15 @@ static const unsigned max_zpage_size = PAGE_SIZE / 4 * 3;
  * otherwise, xv_malloc() would always return failure.
  */
 
+/*
+ * Max no. of pages written to the backing device in one batch. Pages
+ * on adjacent backing slots go out in a single bio.
+ */
+#define RZS_WB_BATCH		32
+
+/* Max no. of pool pages compacted with the table lock held */
+#define RZS_COMPACT_BATCH	64
+
 /*-- End of configurable params */
 
 #define SECTOR_SHIFT		9
@@ -71,19 +88,45 @@ enum rzs_pageflags {
 	/* Page consists entirely of zeros */
 	RZS_ZERO,
 
+	/* Page is filled with a single repeated word */
+	RZS_PATTERN,
+
+	/* Page has been written to the backing device */
+	RZS_BACKED,
+
+	/* Page is being written to the backing device */
+	RZS_WB,
+
 	__NR_RZS_PAGEFLAGS,
 };
 
 /*-- Data structures */
 
+/*
+ * Compressed object. Swap slots storing identical data share a single
+ * object, which is freed when the last of them is freed.
+ */
+struct rzs_obj {
+	struct hlist_node hnode;	/* in rzs->obj_hash */
+	u32 checksum;			/* of the compressed data */
+	u32 refcount;
+	struct page *page;
+	u16 offset;
+	u16 size;			/* compressed size */
+};
+
 /*
  * Allocated for each swap slot, indexed by page no.
  * These table entries must fit exactly in a page.
  */
 struct table {
-	struct page *page;
-	u16 offset;
-	u8 count;	/* object ref count (not yet used) */
+	union {
+		struct page *page;	/* RZS_UNCOMPRESSED */
+		struct rzs_obj *obj;	/* compressed */
+		unsigned long element;	/* RZS_PATTERN */
+		unsigned long bd_slot;	/* RZS_BACKED */
+	};
+	u8 count;	/* writeback passes since last written */
 	u8 flags;
 } __attribute__((aligned(4)));
 
@@ -91,6 +134,8 @@ struct ramzswap_stats {
 	/* basic stats */
 	size_t compr_size;	/* compressed size of pages stored -
 				 * needed to enforce memlimit */
+	size_t dedup_size;	/* compressed size of pages sharing
+				 * another page's object */
 	/* more stats */
 #if defined(CONFIG_RAMZSWAP_STATS)
 	u64 num_reads;		/* failed + successful */
@@ -99,20 +144,54 @@ struct ramzswap_stats {
 	u64 failed_writes;	/* can happen when memory is too low */
 	u64 invalid_io;		/* non-swap I/O requests */
 	u64 notify_free;	/* no. of swap slot free notifications */
+	u64 bd_reads;		/* pages read from backing device */
+	u64 bd_writes;		/* pages written to backing device */
+	u64 objs_moved;		/* objects moved by compaction */
+	u64 pages_compacted;	/* pool pages freed by compaction */
 	u32 pages_zero;		/* no. of zero filled pages */
+	u32 pages_pattern;	/* no. of single word filled pages */
+	u32 pages_dedup;	/* no. of pages sharing an object */
 	u32 pages_stored;	/* no. of pages currently stored */
 	u32 good_compress;	/* % of pages with compression ratio<=50% */
 	u32 pages_expand;	/* % of incompressible pages */
+	u32 pages_backed;	/* no. of pages on backing device */
 #endif
 };
 
+/*
+ * Per-CPU compression stream. The mutex is needed since a writer may be
+ * migrated to another CPU while it is using the stream. Reads cannot
+ * sleep, so they use a separate transform with preemption disabled.
+ */
+struct rzs_cstream {
+	struct mutex lock;
+	struct crypto_comp *tfm;	/* compression, under lock */
+	struct crypto_comp *dtfm;	/* decompression, CPU local */
+	void *buffer;		/* compressed output (2 pages) */
+
+	/* Benchmark mode only, under lock */
+	struct crypto_comp *bench_tfm[RZS_NR_BENCH];
+	void *bench_buffer;	/* compressed output (2 pages) */
+	void *bench_page;	/* decompressed output */
+};
+
+/* Benchmark results for one algorithm, protected by stat64_lock */
+struct rzs_bench_stats {
+	u64 samples;
+	u64 orig_bytes;
+	u64 compr_bytes;
+	u64 compr_ns;
+	u64 decompr_ns;
+};
+
 struct ramzswap {
 	struct xv_pool *mem_pool;
-	void *compress_workmem;
-	void *compress_buffer;
+	struct rzs_cstream *cstreams;	/* per-CPU */
 	struct table *table;
+	struct hlist_head *obj_hash;	/* objects by checksum */
+	u32 obj_hash_mask;
 	spinlock_t stat64_lock;	/* protect 64-bit stats */
-	struct mutex lock;
+	rwlock_t table_lock;	/* protect table, objects and 32-bit stats */
 	struct request_queue *queue;
 	struct gendisk *disk;
 	int init_done;
@@ -123,6 +202,37 @@ struct ramzswap {
 	 */
 	size_t disksize;	/* bytes */
 
+	/*
+	 * Optional backing device. Idle and incompressible pages are
+	 * written to it by RZSIO_WRITEBACK. The slot bitmap and cursor
+	 * are protected by table_lock.
+	 */
+	char backing_name[MAX_SWAP_NAME_LEN];
+	struct block_device *backing_bdev;
+	unsigned long *bd_map;		/* used backing slots */
+	unsigned long bd_pages;		/* backing device size */
+	unsigned long bd_cursor;	/* next slot to try */
+	struct mutex wb_lock;		/* serialize writeback passes */
+
+	/*
+	 * Compaction moves objects around with the table lock held for
+	 * writing. Writers hold compact_sem for reading from allocating
+	 * an object until it is in the table, since they fill it in
+	 * without the table lock.
+	 */
+	struct rw_semaphore compact_sem;
+	struct shrinker shrinker;	/* compacts on memory pressure */
+
+	char compressor[RZS_MAX_COMP_NAME];
+
+	/*
+	 * Benchmark mode: one in bench_interval pages written is also
+	 * compressed with each of rzs_bench_algs.
+	 */
+	u32 bench_interval;
+	atomic_t bench_count;
+	struct rzs_bench_stats bench[RZS_NR_BENCH];
+
 	struct ramzswap_stats stats;
 };
 
@@ -147,6 +257,13 @@ static void rzs_stat64_inc(struct ramzswap *rzs, u64 *v)
 	spin_unlock(&rzs->stat64_lock);
 }
 
+static void rzs_stat64_add(struct ramzswap *rzs, u64 *v, u64 n)
+{
+	spin_lock(&rzs->stat64_lock);
+	*v = *v + n;
+	spin_unlock(&rzs->stat64_lock);
+}
+
 static u64 rzs_stat64_read(struct ramzswap *rzs, u64 *v)
 {
 	u64 val;
@@ -161,6 +278,7 @@ static u64 rzs_stat64_read(struct ramzswap *rzs, u64 *v)
 #define rzs_stat_inc(v)
 #define rzs_stat_dec(v)
 #define rzs_stat64_inc(r, v)
+#define rzs_stat64_add(r, v, n)
 #define rzs_stat64_read(r, v)
 #endif /* CONFIG_RAMZSWAP_STATS */
 
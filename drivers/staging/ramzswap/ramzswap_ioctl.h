@@ -15,6 +15,12 @@
 #ifndef _RAMZSWAP_IOCTL_H_
 #define _RAMZSWAP_IOCTL_H_
 
+#define MAX_SWAP_NAME_LEN	128
+#define RZS_MAX_COMP_NAME	64
+
+/* No. of algorithms compared in benchmark mode: lzo, deflate */
+#define RZS_NR_BENCH		2
+
 struct ramzswap_ioctl_stats {
 	u64 disksize;		/* user specified or equal to backing swap
 				 * size (if present) */
@@ -34,9 +40,45 @@ struct ramzswap_ioctl_stats {
 	u64 mem_used_total;
 } __attribute__ ((packed, aligned(4)));
 
+/*
+ * Counters added after ramzswap_ioctl_stats. They have an ioctl of their
+ * own, since the size of ramzswap_ioctl_stats is part of RZSIO_GET_STATS.
+ */
+struct ramzswap_ioctl_stats_ext {
+	u32 pages_pattern;	/* no. of single word filled pages */
+	u32 pages_dedup;	/* no. of pages sharing another's object */
+	u64 dedup_saved;	/* compressed bytes not stored due to
+				 * sharing */
+	u32 pages_backed;	/* no. of pages on backing device */
+	u64 bd_reads;		/* pages read from backing device */
+	u64 bd_writes;		/* pages written to backing device */
+	u32 frag_pct;		/* % of pool memory not used by objects */
+	u64 objs_moved;		/* objects moved by compaction */
+	u64 pages_compacted;	/* pool pages freed by compaction */
+} __attribute__ ((packed, aligned(4)));
+
+struct ramzswap_ioctl_bench {
+	char compressor[RZS_MAX_COMP_NAME];	/* used by the device */
+	struct {
+		char name[16];
+		u64 samples;		/* no. of pages compressed */
+		u64 orig_bytes;		/* --do-- before compression */
+		u64 compr_bytes;	/* --do-- after compression */
+		u64 compr_ns;		/* time spent compressing */
+		u64 decompr_ns;		/* time spent decompressing */
+	} alg[RZS_NR_BENCH];
+} __attribute__ ((packed, aligned(4)));
+
 #define RZSIO_SET_DISKSIZE_KB	_IOW('z', 0, size_t)
 #define RZSIO_GET_STATS		_IOR('z', 1, struct ramzswap_ioctl_stats)
 #define RZSIO_INIT		_IO('z', 2)
 #define RZSIO_RESET		_IO('z', 3)
+#define RZSIO_SET_BACKING_SWAP	_IOW('z', 4, unsigned char[MAX_SWAP_NAME_LEN])
+#define RZSIO_WRITEBACK		_IOW('z', 5, u32)
+#define RZSIO_COMPACT		_IO('z', 6)
+#define RZSIO_SET_COMPRESSOR	_IOW('z', 7, unsigned char[RZS_MAX_COMP_NAME])
+#define RZSIO_SET_BENCH		_IOW('z', 8, u32)
+#define RZSIO_GET_BENCH		_IOR('z', 9, struct ramzswap_ioctl_bench)
+#define RZSIO_GET_STATS_EXT	_IOR('z', 10, struct ramzswap_ioctl_stats_ext)
 
 #endif
@@ -45,6 +45,12 @@ static void clear_flag(struct block_header *block, enum blockflags flag)
 	block->prev &= ~BIT(flag);
 }
 
+static void add_used(struct xv_pool *pool, struct page *page, int bytes)
+{
+	set_page_private(page, page_private(page) + bytes);
+	pool->used_bytes += bytes;
+}
+
 /*
  * Given <page, offset> pair, provide a derefrencable pointer.
  * This is called from xv_malloc/xv_free path, so it
@@ -287,6 +293,9 @@ static int grow_pool(struct xv_pool *pool, gfp_t flags)
 	stat_inc(&pool->total_pages);
 
 	spin_lock(&pool->lock);
+	set_page_private(page, 0);
+	list_add(&page->lru, &pool->pages);
+
 	block = get_ptr_atomic(page, 0, KM_USER0);
 
 	block->size = PAGE_SIZE - XV_ALIGN;
@@ -317,6 +326,7 @@ struct xv_pool *xv_create_pool(void)
 		return NULL;
 
 	spin_lock_init(&pool->lock);
+	INIT_LIST_HEAD(&pool->pages);
 
 	return pool;
 }
@@ -326,55 +336,21 @@ void xv_destroy_pool(struct xv_pool *pool)
 	kfree(pool);
 }
 
-/**
- * xv_malloc - Allocate block of given size from pool.
- * @pool: pool to allocate from
- * @size: size of block to allocate
- * @page: page no. that holds the object
- * @offset: location of object within page
- *
- * On success, <page, offset> identifies block allocated
- * and 0 is returned. On failure, <page, offset> is set to
- * 0 and -ENOMEM is returned.
- *
- * Allocation requests with size > XV_MAX_ALLOC_SIZE will fail.
+/*
+ * Allocate block of given size from the free lists, without growing
+ * the pool. Called with the pool lock held.
  */
-int xv_malloc(struct xv_pool *pool, u32 size, struct page **page,
-		u32 *offset, gfp_t flags)
+static int alloc_block(struct xv_pool *pool, u32 origsize,
+			struct page **page, u32 *offset)
 {
-	int error;
-	u32 index, tmpsize, origsize, tmpoffset;
+	u32 index, size, tmpsize, tmpoffset;
 	struct block_header *block, *tmpblock;
 
-	*page = NULL;
-	*offset = 0;
-	origsize = size;
-
-	if (unlikely(!size || size > XV_MAX_ALLOC_SIZE))
-		return -ENOMEM;
-
-	size = ALIGN(size, XV_ALIGN);
-
-	spin_lock(&pool->lock);
+	size = ALIGN(origsize, XV_ALIGN);
 
 	index = find_block(pool, size, page, offset);
-
-	if (!*page) {
-		spin_unlock(&pool->lock);
-		if (flags & GFP_NOWAIT)
-			return -ENOMEM;
-		error = grow_pool(pool, flags);
-		if (unlikely(error))
-			return error;
-
-		spin_lock(&pool->lock);
-		index = find_block(pool, size, page, offset);
-	}
-
-	if (!*page) {
-		spin_unlock(&pool->lock);
+	if (!*page)
 		return -ENOMEM;
-	}
 
 	block = get_ptr_atomic(*page, *offset, KM_USER0);
 
@@ -407,13 +383,58 @@ int xv_malloc(struct xv_pool *pool, u32 size, struct page **page,
 	clear_flag(block, BLOCK_FREE);
 
 	put_ptr_atomic(block, KM_USER0);
-	spin_unlock(&pool->lock);
 
+	add_used(pool, *page, size + XV_ALIGN);
 	*offset += XV_ALIGN;
 
 	return 0;
 }
 
+/**
+ * xv_malloc - Allocate block of given size from pool.
+ * @pool: pool to allocate from
+ * @size: size of block to allocate
+ * @page: page no. that holds the object
+ * @offset: location of object within page
+ *
+ * On success, <page, offset> identifies block allocated
+ * and 0 is returned. On failure, <page, offset> is set to
+ * 0 and -ENOMEM is returned.
+ *
+ * Allocation requests with size > XV_MAX_ALLOC_SIZE will fail.
+ */
+int xv_malloc(struct xv_pool *pool, u32 size, struct page **page,
+		u32 *offset, gfp_t flags)
+{
+	int error;
+
+	*page = NULL;
+	*offset = 0;
+
+	if (unlikely(!size || size > XV_MAX_ALLOC_SIZE))
+		return -ENOMEM;
+
+	spin_lock(&pool->lock);
+
+	error = alloc_block(pool, size, page, offset);
+
+	if (error) {
+		spin_unlock(&pool->lock);
+		if (flags & GFP_NOWAIT)
+			return -ENOMEM;
+		error = grow_pool(pool, flags);
+		if (unlikely(error))
+			return error;
+
+		spin_lock(&pool->lock);
+		error = alloc_block(pool, size, page, offset);
+	}
+
+	spin_unlock(&pool->lock);
+
+	return error;
+}
+
 /*
  * Free block identified with <page, offset>
  */
@@ -433,6 +454,7 @@ void xv_free(struct xv_pool *pool, struct page *page, u32 offset)
 	BUG_ON(test_flag(block, BLOCK_FREE));
 
 	block->size = ALIGN(block->size, XV_ALIGN);
+	add_used(pool, page, -(block->size + XV_ALIGN));
 
 	tmpblock = BLOCK_NEXT(block);
 	if (offset + block->size + XV_ALIGN == PAGE_SIZE)
@@ -469,6 +491,7 @@ void xv_free(struct xv_pool *pool, struct page *page, u32 offset)
 	/* No used objects in this page. Free it. */
 	if (block->size == PAGE_SIZE - XV_ALIGN) {
 		put_ptr_atomic(page_start, KM_USER0);
+		list_del(&page->lru);
 		spin_unlock(&pool->lock);
 
 		__free_page(page);
@@ -505,3 +528,176 @@ u64 xv_get_total_size_bytes(struct xv_pool *pool)
 {
 	return pool->total_pages << PAGE_SHIFT;
 }
+
+/*
+ * Returns memory used by objects, including block headers
+ */
+u64 xv_get_used_size_bytes(struct xv_pool *pool)
+{
+	return pool->used_bytes;
+}
+
+/*
+ * Take all free blocks of the page off the free lists, so that objects
+ * being moved out of the page cannot be placed back into it.
+ */
+static void isolate_page(struct xv_pool *pool, struct page *page)
+{
+	u32 offset, size;
+	void *page_start;
+	struct block_header *block;
+
+	page_start = get_ptr_atomic(page, 0, KM_USER0);
+
+	for (offset = 0; offset < PAGE_SIZE; offset += size + XV_ALIGN) {
+		block = (struct block_header *)((char *)page_start + offset);
+		size = ALIGN(block->size, XV_ALIGN);
+
+		if (test_flag(block, BLOCK_FREE) &&
+				block->size >= XV_MIN_ALLOC_SIZE)
+			remove_block(pool, page, offset, block,
+				    get_index_for_insert(block->size));
+	}
+
+	put_ptr_atomic(page_start, KM_USER0);
+}
+
+/*
+ * Move objects out of an isolated page until the free lists have no
+ * more room for them. Moved out blocks are only marked free here.
+ */
+static void evacuate_page(struct xv_pool *pool, struct page *page,
+			xv_move_fn move, void *arg)
+{
+	int free;
+	u32 offset, size, new_offset;
+	void *obj;
+	struct page *new_page;
+	struct block_header *block;
+
+	for (offset = 0; offset < PAGE_SIZE;
+			offset += ALIGN(size, XV_ALIGN) + XV_ALIGN) {
+		block = get_ptr_atomic(page, offset, KM_USER0);
+		size = block->size;
+		free = test_flag(block, BLOCK_FREE);
+		put_ptr_atomic(block, KM_USER0);
+
+		if (free)
+			continue;
+
+		if (alloc_block(pool, size, &new_page, &new_offset))
+			return;
+
+		block = get_ptr_atomic(page, offset, KM_USER0);
+		obj = get_ptr_atomic(new_page, new_offset, KM_USER1);
+
+		memcpy(obj, (char *)block + XV_ALIGN, size);
+		move(obj, new_page, new_offset, arg);
+
+		set_flag(block, BLOCK_FREE);
+		put_ptr_atomic(obj, KM_USER1);
+		put_ptr_atomic(block, KM_USER0);
+
+		add_used(pool, page, -(ALIGN(size, XV_ALIGN) + XV_ALIGN));
+	}
+}
+
+/*
+ * Return an isolated page to the pool: coalesce its free blocks and
+ * put them back on the free lists, or free the page if it is empty.
+ * Returns 1 if the page was freed.
+ */
+static int release_page(struct xv_pool *pool, struct page *page)
+{
+	u32 offset, size, prev = 0, free_offset = 0;
+	void *page_start;
+	struct block_header *block, *free = NULL;
+
+	if (!page_private(page)) {
+		list_del(&page->lru);
+		__free_page(page);
+		stat_dec(&pool->total_pages);
+		return 1;
+	}
+
+	page_start = get_ptr_atomic(page, 0, KM_USER0);
+
+	for (offset = 0; offset < PAGE_SIZE; offset += size + XV_ALIGN) {
+		block = (struct block_header *)((char *)page_start + offset);
+		size = ALIGN(block->size, XV_ALIGN);
+
+		if (test_flag(block, BLOCK_FREE)) {
+			if (free) {
+				free->size += size + XV_ALIGN;
+				continue;
+			}
+			free = block;
+			free_offset = offset;
+			block->size = size;
+			clear_flag(block, PREV_FREE);
+			set_blockprev(block, prev);
+			continue;
+		}
+
+		if (free) {
+			if (free->size >= XV_MIN_ALLOC_SIZE)
+				insert_block(pool, page, free_offset, free);
+			set_flag(block, PREV_FREE);
+			set_blockprev(block, free_offset);
+			free = NULL;
+		} else {
+			clear_flag(block, PREV_FREE);
+			set_blockprev(block, prev);
+		}
+		prev = offset;
+	}
+
+	if (free && free->size >= XV_MIN_ALLOC_SIZE)
+		insert_block(pool, page, free_offset, free);
+
+	put_ptr_atomic(page_start, KM_USER0);
+
+	return 0;
+}
+
+/**
+ * xv_compact - Move objects out of sparsely used pages.
+ * @pool: pool to compact
+ * @nr_pages: no. of pages to scan
+ * @move: called for each object moved, with the new copy mapped
+ * @arg: passed to @move
+ *
+ * Pages are scanned round-robin, continuing where the previous call
+ * stopped. Objects in pages using at most XV_COMPACT_MAX_USED bytes are
+ * moved into free blocks of other pages; the pool is never grown.
+ *
+ * @move is called with the pool lock held and must update all
+ * references to the object. The caller must make sure the objects are
+ * not accessed or freed meanwhile.
+ *
+ * Returns the no. of pages freed.
+ */
+u32 xv_compact(struct xv_pool *pool, u32 nr_pages, xv_move_fn move,
+		void *arg)
+{
+	u32 freed = 0;
+	struct page *page;
+
+	spin_lock(&pool->lock);
+
+	while (nr_pages-- && !list_empty(&pool->pages)) {
+		page = list_first_entry(&pool->pages, struct page, lru);
+		list_move_tail(&page->lru, &pool->pages);
+
+		if (page_private(page) > XV_COMPACT_MAX_USED)
+			continue;
+
+		isolate_page(pool, page);
+		evacuate_page(pool, page, move, arg);
+		freed += release_page(pool, page);
+	}
+
+	spin_unlock(&pool->lock);
+
+	return freed;
+}
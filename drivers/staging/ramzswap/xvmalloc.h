@@ -17,6 +17,10 @@
 
 struct xv_pool;
 
+/* Called by xv_compact() for each object moved to <page, offset> */
+typedef void (*xv_move_fn)(void *obj, struct page *page, u32 offset,
+			void *arg);
+
 struct xv_pool *xv_create_pool(void);
 void xv_destroy_pool(struct xv_pool *pool);
 
@@ -26,5 +30,9 @@ void xv_free(struct xv_pool *pool, struct page *page, u32 offset);
 
 u32 xv_get_object_size(void *obj);
 u64 xv_get_total_size_bytes(struct xv_pool *pool);
+u64 xv_get_used_size_bytes(struct xv_pool *pool);
+
+u32 xv_compact(struct xv_pool *pool, u32 nr_pages, xv_move_fn move,
+			void *arg);
 
 #endif
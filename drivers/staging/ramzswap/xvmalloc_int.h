@@ -14,6 +14,7 @@
 #define _XV_MALLOC_INT_H_
 
 #include <linux/kernel.h>
+#include <linux/list.h>
 #include <linux/types.h>
 
 /* User configurable params */
@@ -36,6 +37,9 @@
 
 #define MAX_FLI		DIV_ROUND_UP(NUM_FREE_LISTS, BITS_PER_LONG)
 
+/* Compaction moves objects out of pages using at most this many bytes */
+#define XV_COMPACT_MAX_USED	(PAGE_SIZE / 4)
+
 /* End of user params */
 
 enum blockflags {
@@ -79,8 +83,16 @@ struct xv_pool {
 
 	struct freelist_entry freelist[NUM_FREE_LISTS];
 
+	/*
+	 * All pages of the pool, scanned round-robin by compaction.
+	 * page->private holds the bytes in use in each page, including
+	 * block headers.
+	 */
+	struct list_head pages;
+
 	/* stats */
 	u64 total_pages;
+	u64 used_bytes;
 };
 
 #endif
@@ -368,6 +368,36 @@ static int proc_pid_schedstat(struct task_struct *task, char *buffer)
 }
 #endif
 
+/*
+ * Provides /proc/PID/reclaimstat: number of direct reclaim stalls, and
+ * the total and longest time spent in them, in nanoseconds
+ */
+static int proc_pid_reclaimstat(struct task_struct *task, char *buffer)
+{
+	return sprintf(buffer, "%lu %llu %llu\n",
+			task->reclaim_stalls,
+			(unsigned long long)task->reclaim_stall_ns,
+			(unsigned long long)task->reclaim_stall_max_ns);
+}
+
+#ifdef CONFIG_KSM
+/*
+ * Provides /proc/PID/ksm_merging_pages: number of pages of the process
+ * that are currently merged by KSM
+ */
+static int proc_pid_ksm_merging_pages(struct task_struct *task, char *buffer)
+{
+	struct mm_struct *mm = get_task_mm(task);
+	int res = 0;
+
+	if (mm) {
+		res = sprintf(buffer, "%lu\n", mm->ksm_merging_pages);
+		mmput(mm);
+	}
+	return res;
+}
+#endif
+
 #ifdef CONFIG_LATENCYTOP
 static int lstats_show_proc(struct seq_file *m, void *v)
 {
@@ -2647,6 +2677,10 @@ static const struct pid_entry tgid_base_stuff[] = {
 #endif
 #ifdef CONFIG_SCHEDSTATS
 	INF("schedstat",  S_IRUGO, proc_pid_schedstat),
+#endif
+	INF("reclaimstat", S_IRUGO, proc_pid_reclaimstat),
+#ifdef CONFIG_KSM
+	INF("ksm_merging_pages", S_IRUSR, proc_pid_ksm_merging_pages),
 #endif
 #ifdef CONFIG_LATENCYTOP
 	REG("latency",  S_IRUGO, proc_lstats_operations),
@@ -2981,6 +3015,10 @@ static const struct pid_entry tid_base_stuff[] = {
 #endif
 #ifdef CONFIG_SCHEDSTATS
 	INF("schedstat", S_IRUGO, proc_pid_schedstat),
+#endif
+	INF("reclaimstat", S_IRUGO, proc_pid_reclaimstat),
+#ifdef CONFIG_KSM
+	INF("ksm_merging_pages", S_IRUSR, proc_pid_ksm_merging_pages),
 #endif
 #ifdef CONFIG_LATENCYTOP
 	REG("latency",  S_IRUGO, proc_lstats_operations),
@@ -23,6 +23,7 @@
 
 #include <linux/types.h>
 #include <linux/mutex.h>
+#include <linux/percpu.h>
 #include <linux/buffer_head.h>
 
 #include "squashfs_fs.h"
@@ -40,9 +41,11 @@ static const struct squashfs_decompressor squashfs_lzma_unsupported_comp_ops = {
 	NULL, NULL, NULL, LZMA_COMPRESSION, "lzma", 0
 };
 
-static const struct squashfs_decompressor squashfs_lzo_unsupported_comp_ops = {
+#ifndef CONFIG_SQUASHFS_LZO
+static const struct squashfs_decompressor squashfs_lzo_comp_ops = {
 	NULL, NULL, NULL, LZO_COMPRESSION, "lzo", 0
 };
+#endif
 
 static const struct squashfs_decompressor squashfs_unknown_comp_ops = {
 	NULL, NULL, NULL, 0, "unknown", 0
@@ -51,7 +54,7 @@ static const struct squashfs_decompressor squashfs_unknown_comp_ops = {
 static const struct squashfs_decompressor *decompressor[] = {
 	&squashfs_zlib_comp_ops,
 	&squashfs_lzma_unsupported_comp_ops,
-	&squashfs_lzo_unsupported_comp_ops,
+	&squashfs_lzo_comp_ops,
 	&squashfs_unknown_comp_ops
 };
 
@@ -66,3 +69,76 @@ const struct squashfs_decompressor *squashfs_lookup_decompressor(int id)
 
 	return decompressor[i];
 }
+
+
+/*
+ * Decompression streams are per-CPU, so that readers running on different
+ * CPUs do not queue behind each other.  A reader uses the stream of the CPU
+ * it started on.  The decompressors wait for buffer I/O and so can sleep,
+ * therefore each stream is protected by a mutex rather than by disabling
+ * preemption.
+ */
+struct squashfs_stream {
+	struct mutex	mutex;
+	void		*stream;
+};
+
+
+void *squashfs_decompressor_init(struct squashfs_sb_info *msblk)
+{
+	int cpu;
+	struct squashfs_stream *percpu, *stream;
+
+	percpu = alloc_percpu(struct squashfs_stream);
+	if (percpu == NULL)
+		return NULL;
+
+	for_each_possible_cpu(cpu) {
+		stream = per_cpu_ptr(percpu, cpu);
+		mutex_init(&stream->mutex);
+		stream->stream = msblk->decompressor->init(msblk);
+		if (stream->stream == NULL)
+			goto failed;
+	}
+
+	return percpu;
+
+failed:
+	squashfs_decompressor_free(msblk, percpu);
+	return NULL;
+}
+
+
+void squashfs_decompressor_free(struct squashfs_sb_info *msblk, void *s)
+{
+	int cpu;
+	struct squashfs_stream *percpu = s;
+
+	if (percpu == NULL)
+		return;
+
+	for_each_possible_cpu(cpu)
+		msblk->decompressor->free(per_cpu_ptr(percpu, cpu)->stream);
+
+	free_percpu(percpu);
+}
+
+
+int squashfs_decompress(struct squashfs_sb_info *msblk, void **buffer,
+	struct buffer_head **bh, int b, int offset, int length, int srclength,
+	int pages)
+{
+	int res;
+	struct squashfs_stream *stream;
+
+	stream = per_cpu_ptr((struct squashfs_stream *) msblk->stream,
+		get_cpu());
+	put_cpu();
+
+	mutex_lock(&stream->mutex);
+	res = msblk->decompressor->decompress(msblk, stream->stream, buffer,
+		bh, b, offset, length, srclength, pages);
+	mutex_unlock(&stream->mutex);
+
+	return res;
+}
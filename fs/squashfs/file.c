@@ -376,6 +376,7 @@ static int squashfs_readpage(struct file *file, struct page *page)
 	struct inode *inode = page->mapping->host;
 	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
 	int bytes, i, offset = 0, sparse = 0;
+	int __maybe_unused res;
 	struct squashfs_cache_entry *buffer = NULL;
 	void *pageaddr;
 
@@ -409,6 +410,18 @@ static int squashfs_readpage(struct file *file, struct page *page)
 				 msblk->block_size;
 			sparse = 1;
 		} else {
+#ifdef CONFIG_SQUASHFS_FILE_DIRECT
+			/*
+			 * Decompress datablock directly into the page cache,
+			 * falling back to the read_page cache if there's
+			 * no memory for that.
+			 */
+			res = squashfs_readpage_block(page, block, bsize);
+			if (res == 0)
+				return 0;
+			if (res != -ENOMEM)
+				goto error_out;
+#endif
 			/*
 			 * Read and decompress datablock.
 			 */
@@ -0,0 +1,137 @@
+/*
+ * Squashfs - a compressed read only filesystem for Linux
+ *
+ * Copyright (c) 2002, 2003, 2004, 2005, 2006, 2007, 2008, 2009
+ * Phillip Lougher <phillip@lougher.demon.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * file_direct.c
+ */
+
+/*
+ * This file implements decompression of datablocks directly into the page
+ * cache.  The pages covered by the datablock are grabbed from the page cache
+ * and the block is decompressed straight into them, rather than into the
+ * read_page cache and then copied into the pages.  This saves a copy of
+ * every datablock read, and datablock reads are no longer serialised on the
+ * single read_page cache entry.
+ */
+
+#include <linux/fs.h>
+#include <linux/vfs.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/pagemap.h>
+#include <linux/highmem.h>
+
+#include "squashfs_fs.h"
+#include "squashfs_fs_sb.h"
+#include "squashfs_fs_i.h"
+#include "squashfs.h"
+
+/*
+ * Read the datablock at block (compressed size bsize) into the page cache
+ * pages it covers, including target_page.  Pages which cannot be grabbed
+ * without blocking, or which are already up to date, have their part of the
+ * block decompressed into a scratch page which is thrown away.
+ *
+ * On success target_page is up to date and unlocked.  On failure it is left
+ * locked for the caller, and on -ENOMEM the caller can fall back to reading
+ * through the read_page cache.
+ */
+int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
+{
+	struct inode *inode = target_page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = target_page->index & ~mask;
+	int end_index = start_index | mask;
+	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	int i, n, pages, avail, res = -ENOMEM;
+	struct page **page = NULL, *scratch;
+	void **buffer = NULL, *pageaddr;
+
+	if (end_index > file_end)
+		end_index = file_end;
+	pages = end_index - start_index + 1;
+
+	scratch = alloc_page(GFP_KERNEL);
+	if (scratch == NULL)
+		goto out;
+
+	page = kmalloc(pages * sizeof(*page), GFP_KERNEL);
+	buffer = kmalloc(pages * sizeof(*buffer), GFP_KERNEL);
+	if (page == NULL || buffer == NULL)
+		goto out;
+
+	for (i = 0, n = start_index; n <= end_index; i++, n++) {
+		page[i] = (n == target_page->index) ? target_page :
+			grab_cache_page_nowait(target_page->mapping, n);
+
+		if (page[i] && page[i] != target_page &&
+				PageUptodate(page[i])) {
+			unlock_page(page[i]);
+			page_cache_release(page[i]);
+			page[i] = NULL;
+		}
+
+		/* Decompression may sleep, so kmap_atomic cannot be used */
+		buffer[i] = kmap(page[i] ? page[i] : scratch);
+	}
+
+	res = squashfs_read_data(inode->i_sb, buffer, block, bsize, NULL,
+		msblk->block_size, pages);
+	if (res < 0)
+		ERROR("Unable to read page, block %llx, size %x\n", block,
+			bsize);
+
+	for (i = 0; i < pages; i++) {
+		kunmap(page[i] ? page[i] : scratch);
+
+		if (page[i] == NULL)
+			continue;
+
+		if (res >= 0) {
+			avail = clamp_t(int, res - i * PAGE_CACHE_SIZE, 0,
+				PAGE_CACHE_SIZE);
+			if (avail < PAGE_CACHE_SIZE) {
+				pageaddr = kmap_atomic(page[i], KM_USER0);
+				memset(pageaddr + avail, 0,
+					PAGE_CACHE_SIZE - avail);
+				kunmap_atomic(pageaddr, KM_USER0);
+			}
+			flush_dcache_page(page[i]);
+			SetPageUptodate(page[i]);
+		} else if (page[i] == target_page)
+			continue;
+
+		unlock_page(page[i]);
+		if (page[i] != target_page)
+			page_cache_release(page[i]);
+	}
+
+	if (res > 0)
+		res = 0;
+
+out:
+	kfree(buffer);
+	kfree(page);
+	if (scratch)
+		__free_page(scratch);
+
+	return res;
+}
@@ -74,6 +74,42 @@ static struct ubifs_compressor zlib_compr = {
 /* All UBIFS compressors */
 struct ubifs_compressor *ubifs_compressors[UBIFS_COMPR_TYPES_CNT];
 
+/**
+ * incompressible - estimate whether data is worth compressing.
+ * @buf: data to check
+ * @len: data length
+ *
+ * This function samples %UBIFS_COMPR_SAMPLE_LEN bytes of @buf in 16-byte
+ * chunks spread over the whole buffer and estimates the collision entropy of
+ * the sample from its byte histogram. Already compressed data like JPEGs or
+ * APKs is close to 8 bits per byte, while anything the compressors can do
+ * something about is well below that. Returns %1 if the estimated entropy is
+ * above 7.5 bits per byte and %0 otherwise.
+ */
+static int incompressible(const void *buf, int len)
+{
+	const u8 *p = buf;
+	u16 cnt[256];
+	int i, j, step, n = 0;
+	u32 sum = 0;
+
+	memset(cnt, 0, sizeof(cnt));
+	step = len / (UBIFS_COMPR_SAMPLE_LEN / 16);
+	for (i = 0; i + 16 <= len && n < UBIFS_COMPR_SAMPLE_LEN; i += step)
+		for (j = 0; j < 16; j++, n++)
+			cnt[p[i + j]] += 1;
+
+	for (i = 0; i < 256; i++)
+		sum += cnt[i] * cnt[i];
+
+	/*
+	 * The probability of two sampled bytes being equal is about
+	 * (sum - n) / (n * (n - 1)), and the collision entropy is minus binary
+	 * logarithm of it. For random data it is 1/256, 181 is 2^7.5.
+	 */
+	return (sum - n) * 181 < n * (n - 1);
+}
+
 /**
  * ubifs_compress - compress data.
  * @in_buf: data to compress
@@ -86,8 +122,8 @@ struct ubifs_compressor *ubifs_compressors[UBIFS_COMPR_TYPES_CNT];
  * This function compresses input buffer @in_buf of length @in_len and stores
  * the result in the output buffer @out_buf and the resulting length in
  * @out_len. If the input buffer does not compress, it is just copied to the
- * @out_buf. The same happens if @compr_type is %UBIFS_COMPR_NONE or if
- * compression error occurred.
+ * @out_buf. The same happens if @compr_type is %UBIFS_COMPR_NONE, if the
+ * data looks incompressible, or if compression error occurred.
  *
  * Note, if the input buffer was not compressed, it is copied to the output
  * buffer and %UBIFS_COMPR_NONE is returned in @compr_type.
@@ -105,6 +141,10 @@ void ubifs_compress(const void *in_buf, int in_len, void *out_buf, int *out_len,
 	if (in_len < UBIFS_MIN_COMPR_LEN)
 		goto no_compr;
 
+	/* Do not waste CPU time on data which will not compress anyway */
+	if (in_len >= UBIFS_COMPR_SAMPLE_LEN && incompressible(in_buf, in_len))
+		goto no_compr;
+
 	if (compr->comp_mutex)
 		mutex_lock(compr->comp_mutex);
 	err = crypto_comp_compress(compr->cc, in_buf, in_len, out_buf,
@@ -33,6 +33,9 @@
 #ifndef __UBIFS_MEDIA_H__
 #define __UBIFS_MEDIA_H__
 
+/* UBIFS compression algorithms (UBIFS_COMPR_NONE, etc) */
+#include <mtd/ubifs-user.h>
+
 /* UBIFS node magic number (must not have the padding byte first or last) */
 #define UBIFS_NODE_MAGIC  0x06101831
 
@@ -326,21 +329,6 @@ enum {
 /* Inode flag bits used by UBIFS */
 #define UBIFS_FL_MASK 0x0000001F
 
-/*
- * UBIFS compression algorithms.
- *
- * UBIFS_COMPR_NONE: no compression
- * UBIFS_COMPR_LZO: LZO compression
- * UBIFS_COMPR_ZLIB: ZLIB compression
- * UBIFS_COMPR_TYPES_CNT: count of supported compression types
- */
-enum {
-	UBIFS_COMPR_NONE,
-	UBIFS_COMPR_LZO,
-	UBIFS_COMPR_ZLIB,
-	UBIFS_COMPR_TYPES_CNT,
-};
-
 /*
  * UBIFS node types.
  *
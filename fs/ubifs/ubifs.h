@@ -153,6 +153,9 @@
 /* Maximum number of data nodes to bulk-read */
 #define UBIFS_MAX_BULK_READ 32
 
+/* How many bytes of a data block to sample when estimating entropy */
+#define UBIFS_COMPR_SAMPLE_LEN 512
+
 /*
  * Lockdep classes for UBIFS inode @ui_mutex.
  */
@@ -195,7 +195,7 @@ struct request {
 
 	struct gendisk *rq_disk;
 	unsigned long start_time;
-#ifdef CONFIG_BLK_CGROUP
+#if defined(CONFIG_BLK_CGROUP) || defined(CONFIG_BLK_DEV_LATENCY_HIST)
 	unsigned long long start_time_ns;
 	unsigned long long io_start_time_ns;    /* when passed to hardware */
 #endif
@@ -329,6 +329,27 @@ struct queue_limits {
 	signed char		discard_zeroes_data;
 };
 
+#ifdef CONFIG_BLK_DEV_LATENCY_HIST
+#define BLK_LATENCY_BUCKETS	24
+
+/*
+ * Per queue latency histograms and merge/plug counters, updated under
+ * the queue lock.  Bucket n counts requests that took less than
+ * 1024 << n nanoseconds, the last bucket counts everything slower.
+ */
+struct blk_latency_hist {
+	unsigned long	queue[BLK_LATENCY_BUCKETS];	/* alloc to dispatch */
+	unsigned long	dispatch[BLK_LATENCY_BUCKETS];	/* dispatch to end */
+	unsigned long	complete[BLK_LATENCY_BUCKETS];	/* alloc to end */
+
+	unsigned long	requests;	/* requests built from a bio */
+	unsigned long	bio_merges;	/* bios merged into a request */
+	unsigned long	rq_merges;	/* requests merged together */
+	unsigned long	plugs;
+	unsigned long	unplugs;
+};
+#endif
+
 struct request_queue
 {
 	/*
@@ -432,6 +453,9 @@ struct request_queue
 	int			node;
 #ifdef CONFIG_BLK_DEV_IO_TRACE
 	struct blk_trace	*blk_trace;
+#endif
+#ifdef CONFIG_BLK_DEV_LATENCY_HIST
+	struct blk_latency_hist	latency_hist;
 #endif
 	/*
 	 * reserved for flush operations
@@ -1210,7 +1234,7 @@ static inline void put_dev_sector(Sector p)
 struct work_struct;
 int kblockd_schedule_work(struct request_queue *q, struct work_struct *work);
 
-#ifdef CONFIG_BLK_CGROUP
+#if defined(CONFIG_BLK_CGROUP) || defined(CONFIG_BLK_DEV_LATENCY_HIST)
 /*
  * This should not be using sched_clock(). A real patch is in progress
  * to fix this up, until that is in place we need to disable preemption
@@ -23,6 +23,11 @@ extern int fragmentation_index(struct zone *zone, unsigned int order);
 extern unsigned long try_to_compact_pages(struct zonelist *zonelist,
 			int order, gfp_t gfp_mask, nodemask_t *mask);
 
+extern void wakeup_kcompactd(struct zone *zone, int order);
+extern void compaction_fastpath_alloc(struct zone *zone, int order);
+extern int kcompactd_run_node(int nid);
+extern void kcompactd_stop_node(int nid);
+
 /* Do not skip compaction more than 64 times */
 #define COMPACT_MAX_DEFER_SHIFT 6
 
@@ -63,6 +68,23 @@ static inline void defer_compaction(struct zone *zone)
 {
 }
 
+static inline void wakeup_kcompactd(struct zone *zone, int order)
+{
+}
+
+static inline void compaction_fastpath_alloc(struct zone *zone, int order)
+{
+}
+
+static inline int kcompactd_run_node(int nid)
+{
+	return 0;
+}
+
+static inline void kcompactd_stop_node(int nid)
+{
+}
+
 static inline bool compaction_deferred(struct zone *zone)
 {
 	return 1;
@@ -20,18 +20,49 @@ struct page *ksm_does_need_to_copy(struct page *page,
 			struct vm_area_struct *vma, unsigned long address);
 
 #ifdef CONFIG_KSM
+/* vmas that KSM will not merge in, whatever madvise says */
+#define VM_KSM_UNMERGEABLE	(VM_SHARED    | VM_MAYSHARE | VM_PFNMAP    | \
+				 VM_IO        | VM_DONTEXPAND | VM_RESERVED | \
+				 VM_HUGETLB   | VM_INSERTPAGE | VM_NONLINEAR | \
+				 VM_MIXEDMAP  | VM_SAO)
+
+extern unsigned int ksm_auto;
+
 int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		unsigned long end, int advice, unsigned long *vm_flags);
 int __ksm_enter(struct mm_struct *mm);
 void __ksm_exit(struct mm_struct *mm);
+void __ksm_auto_fork(struct mm_struct *mm, struct mm_struct *oldmm);
 
 static inline int ksm_fork(struct mm_struct *mm, struct mm_struct *oldmm)
 {
-	if (test_bit(MMF_VM_MERGEABLE, &oldmm->flags))
+	mm->ksm_merging_pages = 0;
+	if (ksm_auto)
+		__ksm_auto_fork(mm, oldmm);
+	if (test_bit(MMF_VM_MERGEABLE, &oldmm->flags) ||
+	    test_bit(MMF_VM_MERGE_AUTO, &mm->flags))
 		return __ksm_enter(mm);
 	return 0;
 }
 
+/*
+ * In automatic mode every private anonymous vma of the mm is mergeable:
+ * called with mmap_sem held for writing on the flags of a new or copied
+ * vma, @file being the file it maps, if any.
+ */
+static inline unsigned long ksm_auto_vm_flags(struct mm_struct *mm,
+					      struct file *file,
+					      unsigned long vm_flags)
+{
+	if (!file && test_bit(MMF_VM_MERGE_AUTO, &mm->flags)) {
+		if (vm_flags & VM_KSM_UNMERGEABLE)
+			vm_flags &= ~VM_MERGEABLE;
+		else
+			vm_flags |= VM_MERGEABLE;
+	}
+	return vm_flags;
+}
+
 static inline void ksm_exit(struct mm_struct *mm)
 {
 	if (test_bit(MMF_VM_MERGEABLE, &mm->flags))
@@ -97,6 +128,13 @@ static inline int ksm_fork(struct mm_struct *mm, struct mm_struct *oldmm)
 	return 0;
 }
 
+static inline unsigned long ksm_auto_vm_flags(struct mm_struct *mm,
+					      struct file *file,
+					      unsigned long vm_flags)
+{
+	return vm_flags;
+}
+
 static inline void ksm_exit(struct mm_struct *mm)
 {
 }
@@ -73,6 +73,7 @@ extern int mem_cgroup_shmem_charge_fallback(struct page *page,
 
 extern void mem_cgroup_out_of_memory(struct mem_cgroup *mem, gfp_t gfp_mask);
 int task_in_mem_cgroup(struct task_struct *task, const struct mem_cgroup *mem);
+extern unsigned long mem_cgroup_task_pages(struct task_struct *p);
 
 extern struct mem_cgroup *try_get_mem_cgroup_from_page(struct page *page);
 extern struct mem_cgroup *mem_cgroup_from_task(struct task_struct *p);
@@ -222,6 +223,11 @@ static inline int task_in_mem_cgroup(struct task_struct *task,
 	return 1;
 }
 
+static inline unsigned long mem_cgroup_task_pages(struct task_struct *p)
+{
+	return 0;
+}
+
 static inline struct cgroup_subsys_state *mem_cgroup_css(struct mem_cgroup *mem)
 {
 	return NULL;
@@ -1332,6 +1332,23 @@ unsigned long ra_submit(struct file_ra_state *ra,
 			struct address_space *mapping,
 			struct file *filp);
 
+/* readahead_history.c */
+#ifdef CONFIG_READAHEAD_HISTORY
+extern int sysctl_readahead_history;
+void ra_history_record(struct address_space *mapping,
+		       pgoff_t start, unsigned long nr);
+void ra_history_prefetch(struct address_space *mapping, struct file *filp);
+#else
+static inline void ra_history_record(struct address_space *mapping,
+				     pgoff_t start, unsigned long nr)
+{
+}
+static inline void ra_history_prefetch(struct address_space *mapping,
+				       struct file *filp)
+{
+}
+#endif
+
 /* Do stack extension */
 extern int expand_stack(struct vm_area_struct *vma, unsigned long address);
 #if VM_GROWSUP
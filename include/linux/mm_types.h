@@ -310,6 +310,10 @@ struct mm_struct {
 #ifdef CONFIG_MMU_NOTIFIER
 	struct mmu_notifier_mm *mmu_notifier_mm;
 #endif
+#ifdef CONFIG_KSM
+	/* pages of this mm that ksmd has merged */
+	unsigned long ksm_merging_pages;
+#endif
 };
 
 /* Future-safe accessor for struct mm_struct's cpu_vm_mask. */
@@ -166,6 +166,13 @@ enum zone_watermarks {
 #define low_wmark_pages(z) (z->watermark[WMARK_LOW])
 #define high_wmark_pages(z) (z->watermark[WMARK_HIGH])
 
+/*
+ * Orders 1 to PCP_MAX_ORDER are also cached per cpu, so that kernel
+ * stacks, skb heads and similar small high-order allocations do not
+ * have to take zone->lock every time.
+ */
+#define PCP_MAX_ORDER	PAGE_ALLOC_COSTLY_ORDER
+
 struct per_cpu_pages {
 	int count;		/* number of pages in the list */
 	int high;		/* high watermark, emptying needed */
@@ -173,6 +180,10 @@ struct per_cpu_pages {
 
 	/* Lists of pages, one per migrate type stored on the pcp-lists */
 	struct list_head lists[MIGRATE_PCPTYPES];
+
+	/* Blocks of order 1..PCP_MAX_ORDER, indexed by order - 1 */
+	int order_count[PCP_MAX_ORDER];
+	struct list_head order_lists[PCP_MAX_ORDER][MIGRATE_PCPTYPES];
 };
 
 struct per_cpu_pageset {
@@ -336,6 +347,13 @@ struct zone {
 	 */
 	unsigned int		compact_considered;
 	unsigned int		compact_defer_shift;
+
+	/*
+	 * Blocks of compact_credit_order kcompactd made available that no
+	 * allocation used yet
+	 */
+	atomic_t		compact_credit;
+	int			compact_credit_order;
 #endif
 
 	ZONE_PADDING(_pad1_)
@@ -375,6 +393,8 @@ struct zone {
 	 */
 	unsigned int inactive_ratio;
 
+	/* Evictions and activations of file pages, see mm/workingset.c */
+	atomic_long_t		inactive_age;
 
 	ZONE_PADDING(_pad2_)
 	/* Rarely used or read-mostly fields */
@@ -650,6 +670,11 @@ typedef struct pglist_data {
 	wait_queue_head_t kswapd_wait;
 	struct task_struct *kswapd;
 	int kswapd_max_order;
+#ifdef CONFIG_COMPACTION
+	wait_queue_head_t kcompactd_wait;
+	struct task_struct *kcompactd;
+	int kcompactd_max_order;
+#endif
 } pg_data_t;
 
 #define node_present_pages(nid)	(NODE_DATA(nid)->node_present_pages)
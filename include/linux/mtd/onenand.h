@@ -180,12 +180,23 @@ struct onenand_chip {
 #define ONENAND_HAS_2PLANE		(0x0004)
 #define ONENAND_HAS_4KB_PAGE		(0x0008)
 #define ONENAND_SKIP_UNLOCK_CHECK	(0x0100)
+#define ONENAND_HAS_2X_BUFFERRAM	(0x0200)
 #define ONENAND_PAGEBUF_ALLOC		(0x1000)
 #define ONENAND_OOBBUF_ALLOC		(0x2000)
 
 #define ONENAND_IS_4KB_PAGE(this)					\
 	(this->options & ONENAND_HAS_4KB_PAGE)
 
+/*
+ * MLC and 4KB page OneNAND use both DataRAMs for one page, so
+ * read-while-load is only possible there when the controller driver
+ * provides two page-sized BufferRAMs of its own.
+ */
+#define ONENAND_IS_READ_WHILE_LOAD(this)				\
+	(!ONENAND_IS_MLC(this) &&					\
+	 (!ONENAND_IS_4KB_PAGE(this) ||					\
+	  (this->options & ONENAND_HAS_2X_BUFFERRAM)))
+
 /*
  * OneNAND Flash Manufacturer ID Codes
  */
@@ -102,4 +102,12 @@
 
 #define PR_MCE_KILL_GET 34
 
+/*
+ * Mark the task latency sensitive: its allocations that may fail do so
+ * instead of entering direct reclaim, and its direct reclaim is bounded
+ * by vm.direct_reclaim_budget_ms.
+ */
+#define PR_SET_RECLAIM_FAILFAST 35
+#define PR_GET_RECLAIM_FAILFAST 36
+
 #endif /* _LINUX_PRCTL_H */
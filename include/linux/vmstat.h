@@ -43,9 +43,19 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		KSWAPD_LOW_WMARK_HIT_QUICKLY, KSWAPD_HIGH_WMARK_HIT_QUICKLY,
 		KSWAPD_SKIP_CONGESTION_WAIT,
 		PAGEOUTRUN, ALLOCSTALL, PGROTATED,
+		PCP_ORDER_ALLOC, PCP_ORDER_REFILL, PCP_ORDER_SPILL,
+		PGALLOC_SLOW, PGALLOC_SLOW_USEC,
+		WORKINGSET_REFAULT, WORKINGSET_ACTIVATE,
+		RECLAIM_STALL_1MS, RECLAIM_STALL_4MS, RECLAIM_STALL_16MS,
+		RECLAIM_STALL_64MS, RECLAIM_STALL_256MS, RECLAIM_STALL_SLOW,
+		RECLAIM_BUDGET_EXCEEDED, RECLAIM_FAILFAST,
+#ifdef CONFIG_READAHEAD_HISTORY
+		RA_HISTORY_PREFETCH,
+#endif
 #ifdef CONFIG_COMPACTION
 		COMPACTBLOCKS, COMPACTPAGES, COMPACTPAGEFAILED,
 		COMPACTSTALL, COMPACTFAIL, COMPACTSUCCESS,
+		COMPACTD_RUN, COMPACTD_AVOIDED,
 #endif
 #ifdef CONFIG_HUGETLB_PAGE
 		HTLB_BUDDY_PGALLOC, HTLB_BUDDY_PGALLOC_FAIL,
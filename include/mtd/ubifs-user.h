@@ -0,0 +1,53 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 51
+ * Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __UBIFS_USER_H__
+#define __UBIFS_USER_H__
+
+#include <linux/ioctl.h>
+
+/*
+ * UBIFS compression algorithms.
+ *
+ * UBIFS_COMPR_NONE: no compression
+ * UBIFS_COMPR_LZO: LZO compression
+ * UBIFS_COMPR_ZLIB: ZLIB compression
+ * UBIFS_COMPR_TYPES_CNT: count of supported compression types
+ *
+ * These values are also stored on the media, see fs/ubifs/ubifs-media.h.
+ */
+enum {
+	UBIFS_COMPR_NONE,
+	UBIFS_COMPR_LZO,
+	UBIFS_COMPR_ZLIB,
+	UBIFS_COMPR_TYPES_CNT,
+};
+
+/*
+ * Per-file compressor selection
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * The compressor of a regular file is read with the %UBIFS_IOC_GETCOMPR and
+ * changed with the %UBIFS_IOC_SETCOMPR ioctl command, both of which take a
+ * pointer to an integer compressor type (%UBIFS_COMPR_NONE, etc). The new
+ * compressor is used for data written from then on. Selecting a compressor
+ * other than %UBIFS_COMPR_NONE also sets the compression flag of the file.
+ */
+#define UBIFS_IOC_MAGIC 'O'
+
+#define UBIFS_IOC_GETCOMPR _IOR(UBIFS_IOC_MAGIC, 0x20, int)
+#define UBIFS_IOC_SETCOMPR _IOW(UBIFS_IOC_MAGIC, 0x21, int)
+
+#endif /* __UBIFS_USER_H__ */
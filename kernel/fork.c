@@ -375,6 +375,10 @@ static int dup_mmap(struct mm_struct *mm, struct mm_struct *oldmm)
 		if (anon_vma_fork(tmp, mpnt))
 			goto fail_nomem_anon_vma_fork;
 		tmp->vm_flags &= ~VM_LOCKED;
+		/* Keep a MADV_UNMERGEABLE done under automatic mode */
+		if (!test_bit(MMF_VM_MERGE_AUTO, &oldmm->flags))
+			tmp->vm_flags = ksm_auto_vm_flags(mm, tmp->vm_file,
+							  tmp->vm_flags);
 		tmp->vm_mm = mm;
 		tmp->vm_next = tmp->vm_prev = NULL;
 		file = tmp->vm_file;
@@ -1084,6 +1088,10 @@ static struct task_struct *copy_process(unsigned long clone_flags,
 
 	p->default_timer_slack_ns = current->timer_slack_ns;
 
+	p->reclaim_stalls = 0;
+	p->reclaim_stall_ns = 0;
+	p->reclaim_stall_max_ns = 0;
+
 	task_io_accounting_init(&p->ioac);
 	acct_clear_integrals(p);
 
@@ -1578,6 +1578,20 @@ SYSCALL_DEFINE5(prctl, int, option, unsigned long, arg2, unsigned long, arg3,
 				current->timer_slack_ns = arg2;
 			error = 0;
 			break;
+		case PR_SET_RECLAIM_FAILFAST:
+			if (arg2 > 1 || arg3 | arg4 | arg5)
+				return -EINVAL;
+			if (arg2)
+				current->flags |= PF_RECLAIM_FAILFAST;
+			else
+				current->flags &= ~PF_RECLAIM_FAILFAST;
+			error = 0;
+			break;
+		case PR_GET_RECLAIM_FAILFAST:
+			if (arg2 | arg3 | arg4 | arg5)
+				return -EINVAL;
+			error = !!(current->flags & PF_RECLAIM_FAILFAST);
+			break;
 		case PR_MCE_KILL:
 			if (arg4 | arg5)
 				return -EINVAL;
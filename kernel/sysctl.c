@@ -1069,6 +1069,24 @@ static struct ctl_table vm_table[] = {
 		.extra1		= &zero,
 		.extra2		= &one_hundred,
 	},
+	{
+		.procname	= "direct_reclaim_budget_ms",
+		.data		= &sysctl_direct_reclaim_budget_ms,
+		.maxlen		= sizeof(sysctl_direct_reclaim_budget_ms),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+	},
+#ifdef CONFIG_READAHEAD_HISTORY
+	{
+		.procname	= "readahead_history",
+		.data		= &sysctl_readahead_history,
+		.maxlen		= sizeof(sysctl_readahead_history),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+	},
+#endif
 #ifdef CONFIG_HUGETLB_PAGE
 	{
 		.procname	= "nr_hugepages",
@@ -14,6 +14,9 @@
 #include <linux/backing-dev.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
+#include <linux/cpumask.h>
 #include "internal.h"
 
 /*
@@ -38,6 +41,9 @@ struct compact_control {
 	unsigned int order;		/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
 	struct zone *zone;
+
+	unsigned long budget;		/* max pages to migrate, 0 = no limit */
+	unsigned long nr_migrated;	/* pages migrated so far */
 };
 
 static unsigned long release_freepages(struct list_head *freelist)
@@ -350,6 +356,10 @@ static int compact_finished(struct zone *zone,
 	if (fatal_signal_pending(current))
 		return COMPACT_PARTIAL;
 
+	/* Background compaction stops once its budget is used up */
+	if (cc->budget && cc->nr_migrated >= cc->budget)
+		return COMPACT_PARTIAL;
+
 	/* Compaction run completes if the migrate and free scanner meet */
 	if (cc->free_pfn <= cc->migrate_pfn)
 		return COMPACT_COMPLETE;
@@ -398,6 +408,7 @@ static int compact_zone(struct zone *zone, struct compact_control *cc)
 		update_nr_listpages(cc);
 		nr_remaining = cc->nr_migratepages;
 
+		cc->nr_migrated += nr_migrate - nr_remaining;
 		count_vm_event(COMPACTBLOCKS);
 		count_vm_events(COMPACTPAGES, nr_migrate - nr_remaining);
 		if (nr_remaining)
@@ -505,6 +516,9 @@ unsigned long try_to_compact_pages(struct zonelist *zonelist,
 		status = compact_zone_order(zone, order, gfp_mask);
 		rc = max(status, rc);
 
+		/* Have kcompactd keep blocks of this size around from now on */
+		wakeup_kcompactd(zone, order);
+
 		if (zone_watermark_ok(zone, order, watermark, 0, 0))
 			break;
 	}
@@ -583,6 +597,287 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+/*
+ * kcompactd compacts in the background, so that high-order allocations
+ * find a free block instead of stalling in direct compaction.  Every
+ * sleep_millisecs it looks at the fragmentation index of each zone of
+ * its node for kcompactd_order, and if an allocation of that order
+ * would fail because of fragmentation, and the system is otherwise
+ * idle, it migrates at most pages_to_migrate pages.  A direct
+ * compaction stall wakes it up straight away for the stalled order.
+ */
+static unsigned int kcompactd_sleep_millisecs = 500;
+static unsigned int kcompactd_pages_to_migrate = 1024;
+static unsigned int kcompactd_order = PAGE_ALLOC_COSTLY_ORDER + 1;
+static unsigned int kcompactd_run = 1;
+static unsigned long kcompactd_passes;
+
+void wakeup_kcompactd(struct zone *zone, int order)
+{
+	pg_data_t *pgdat = zone->zone_pgdat;
+
+	if (!pgdat->kcompactd || !kcompactd_run)
+		return;
+	if (pgdat->kcompactd_max_order < order)
+		pgdat->kcompactd_max_order = order;
+	if (waitqueue_active(&pgdat->kcompactd_wait))
+		wake_up_interruptible(&pgdat->kcompactd_wait);
+}
+
+/*
+ * A high order allocation was satisfied from the free lists.  If kcompactd
+ * made blocks of at least that order available in the zone, count it as a
+ * direct compaction stall that was avoided.
+ */
+void compaction_fastpath_alloc(struct zone *zone, int order)
+{
+	if (order > zone->compact_credit_order)
+		return;
+	if (atomic_add_unless(&zone->compact_credit, -1, 0))
+		count_vm_event(COMPACTD_AVOIDED);
+}
+
+/* Number of free blocks of at least the given order */
+static unsigned long zone_free_blocks(struct zone *zone, int order)
+{
+	unsigned long blocks = 0;
+	int o;
+
+	for (o = order; o < MAX_ORDER; o++)
+		blocks += zone->free_area[o].nr_free << (o - order);
+
+	return blocks;
+}
+
+static bool kcompactd_zone_suitable(struct zone *zone, int order)
+{
+	unsigned long watermark = low_wmark_pages(zone);
+
+	if (!populated_zone(zone) || zone->all_unreclaimable)
+		return false;
+
+	/* A block of this order can already be allocated */
+	if (zone_watermark_ok(zone, order, watermark, 0, 0))
+		return false;
+
+	/* Too little free memory to migrate into, that is for kswapd */
+	if (!zone_watermark_ok(zone, 0, watermark + (2UL << order), 0, 0))
+		return false;
+
+	/* Only compact if a failure would be due to fragmentation */
+	return fragmentation_index(zone, order) > sysctl_extfrag_threshold;
+}
+
+/* Only use spare cpu time, unless a direct compactor is stalling */
+static bool kcompactd_idle(void)
+{
+	return nr_running() <= num_online_cpus();
+}
+
+static void kcompactd_do_work(pg_data_t *pgdat)
+{
+	int stalled = pgdat->kcompactd_max_order;
+	int order = stalled ? stalled : kcompactd_order;
+	int zoneid;
+
+	pgdat->kcompactd_max_order = 0;
+	if (order >= MAX_ORDER || (!stalled && !kcompactd_idle()))
+		return;
+
+	for (zoneid = 0; zoneid < MAX_NR_ZONES; zoneid++) {
+		struct zone *zone = &pgdat->node_zones[zoneid];
+		struct compact_control cc = {
+			.nr_freepages = 0,
+			.nr_migratepages = 0,
+			.order = order,
+			.migratetype = MIGRATE_MOVABLE,
+			.zone = zone,
+			.budget = kcompactd_pages_to_migrate,
+		};
+		unsigned long before, after;
+
+		if (!kcompactd_zone_suitable(zone, order))
+			continue;
+
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+
+		lru_add_drain();
+		before = zone_free_blocks(zone, order);
+		compact_zone(zone, &cc);
+
+		/* Page migration frees to the PCP lists but we want merging */
+		drain_local_pages(NULL);
+
+		/*
+		 * Keep the credit left from earlier passes of the same order,
+		 * but never count more blocks than the zone has free.
+		 */
+		after = zone_free_blocks(zone, order);
+		if (after > before) {
+			if (zone->compact_credit_order != order) {
+				atomic_set(&zone->compact_credit, 0);
+				zone->compact_credit_order = order;
+			}
+			long credit = atomic_add_return(after - before,
+							&zone->compact_credit);
+
+			if (credit > (long)after)
+				atomic_sub(credit - after, &zone->compact_credit);
+		}
+		kcompactd_passes++;
+		count_vm_event(COMPACTD_RUN);
+	}
+}
+
+static int kcompactd(void *p)
+{
+	pg_data_t *pgdat = p;
+	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
+
+	if (!cpumask_empty(cpumask))
+		set_cpus_allowed_ptr(current, cpumask);
+	set_freezable();
+	set_user_nice(current, 19);
+
+	while (!kthread_should_stop()) {
+		if (kcompactd_run)
+			kcompactd_do_work(pgdat);
+
+		try_to_freeze();
+
+		if (kcompactd_run)
+			wait_event_freezable_timeout(pgdat->kcompactd_wait,
+				pgdat->kcompactd_max_order ||
+				kthread_should_stop(),
+				msecs_to_jiffies(kcompactd_sleep_millisecs));
+		else
+			wait_event_freezable(pgdat->kcompactd_wait,
+				kcompactd_run || kthread_should_stop());
+	}
+
+	return 0;
+}
+
+int kcompactd_run_node(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+
+	if (pgdat->kcompactd)
+		return 0;
+
+	pgdat->kcompactd = kthread_run(kcompactd, pgdat, "kcompactd%d", nid);
+	if (IS_ERR(pgdat->kcompactd)) {
+		printk(KERN_ERR "Failed to start kcompactd on node %d\n", nid);
+		pgdat->kcompactd = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+void kcompactd_stop_node(int nid)
+{
+	struct task_struct *kcompactd = NODE_DATA(nid)->kcompactd;
+
+	if (kcompactd) {
+		kthread_stop(kcompactd);
+		NODE_DATA(nid)->kcompactd = NULL;
+	}
+}
+
+#ifdef CONFIG_SYSFS
+#define KCOMPACTD_ATTR_RO(_name) \
+	static struct kobj_attribute _name##_attr = __ATTR_RO(_name)
+#define KCOMPACTD_ATTR(_name) \
+	static struct kobj_attribute _name##_attr = \
+		__ATTR(_name, 0644, _name##_show, _name##_store)
+
+#define KCOMPACTD_UINT_ATTR(_name, _var, _min, _max)			\
+static ssize_t _name##_show(struct kobject *kobj,			\
+			    struct kobj_attribute *attr, char *buf)	\
+{									\
+	return sprintf(buf, "%u\n", _var);				\
+}									\
+static ssize_t _name##_store(struct kobject *kobj,			\
+			     struct kobj_attribute *attr,		\
+			     const char *buf, size_t count)		\
+{									\
+	unsigned long val;						\
+									\
+	if (strict_strtoul(buf, 10, &val) || val < (_min) || val > (_max)) \
+		return -EINVAL;						\
+	_var = val;							\
+	return count;							\
+}									\
+KCOMPACTD_ATTR(_name)
+
+KCOMPACTD_UINT_ATTR(sleep_millisecs, kcompactd_sleep_millisecs, 1, UINT_MAX);
+KCOMPACTD_UINT_ATTR(pages_to_migrate, kcompactd_pages_to_migrate, 0, UINT_MAX);
+KCOMPACTD_UINT_ATTR(order, kcompactd_order, 1, MAX_ORDER - 1);
+
+static ssize_t run_show(struct kobject *kobj, struct kobj_attribute *attr,
+			char *buf)
+{
+	return sprintf(buf, "%u\n", kcompactd_run);
+}
+
+static ssize_t run_store(struct kobject *kobj, struct kobj_attribute *attr,
+			 const char *buf, size_t count)
+{
+	unsigned long val;
+	int nid;
+
+	if (strict_strtoul(buf, 10, &val) || val > 1)
+		return -EINVAL;
+
+	kcompactd_run = val;
+	if (kcompactd_run)
+		for_each_online_node(nid)
+			if (NODE_DATA(nid)->kcompactd)
+				wake_up_interruptible(
+					&NODE_DATA(nid)->kcompactd_wait);
+
+	return count;
+}
+KCOMPACTD_ATTR(run);
+
+static ssize_t passes_show(struct kobject *kobj,
+			   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", kcompactd_passes);
+}
+KCOMPACTD_ATTR_RO(passes);
+
+static struct attribute *kcompactd_attrs[] = {
+	&sleep_millisecs_attr.attr,
+	&pages_to_migrate_attr.attr,
+	&order_attr.attr,
+	&run_attr.attr,
+	&passes_attr.attr,
+	NULL,
+};
+
+static struct attribute_group kcompactd_attr_group = {
+	.attrs = kcompactd_attrs,
+	.name = "kcompactd",
+};
+#endif /* CONFIG_SYSFS */
+
+static int __init kcompactd_init(void)
+{
+	int nid;
+
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		kcompactd_run_node(nid);
+
+#ifdef CONFIG_SYSFS
+	if (sysfs_create_group(mm_kobj, &kcompactd_attr_group))
+		printk(KERN_ERR "kcompactd: register sysfs failed\n");
+#endif
+	return 0;
+}
+module_init(kcompactd_init)
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct sys_device *dev,
 			struct sysdev_attribute *attr,
@@ -450,9 +450,13 @@ int add_to_page_cache_lru(struct page *page, struct address_space *mapping,
 
 	ret = add_to_page_cache(page, mapping, offset, gfp_mask);
 	if (ret == 0) {
-		if (page_is_file_cache(page))
-			lru_cache_add_file(page);
-		else
+		if (page_is_file_cache(page)) {
+			/* recently evicted: part of the working set */
+			if (workingset_refault(mapping, offset))
+				__lru_cache_add(page, LRU_ACTIVE_FILE);
+			else
+				lru_cache_add_file(page);
+		} else
 			lru_cache_add_anon(page);
 	}
 	return ret;
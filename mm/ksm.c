@@ -33,6 +33,7 @@
 #include <linux/mmu_notifier.h>
 #include <linux/swap.h>
 #include <linux/ksm.h>
+#include <linux/earlysuspend.h>
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -190,6 +191,22 @@ static unsigned int ksm_thread_sleep_millisecs = 20;
 #define KSM_RUN_UNMERGE	2
 static unsigned int ksm_run = KSM_RUN_STOP;
 
+/*
+ * Automatic mode: the children of zygote, and their children, have all
+ * their private vmas merged without having to madvise them.
+ */
+unsigned int ksm_auto;
+
+/*
+ * In automatic mode ksmd sleeps up to KSM_AUTO_MAX_BACKOFF times
+ * sleep_millisecs while full scans merge little, and not at all while
+ * the screen is off.
+ */
+#define KSM_AUTO_MAX_BACKOFF	32
+static unsigned int ksm_auto_backoff = 1;
+static long ksm_auto_pass_merged;
+static int ksm_screen_off;
+
 static DECLARE_WAIT_QUEUE_HEAD(ksm_thread_wait);
 static DEFINE_MUTEX(ksm_thread_mutex);
 static DEFINE_SPINLOCK(ksm_mmlist_lock);
@@ -470,6 +487,7 @@ static void remove_node_from_stable_tree(struct stable_node *stable_node)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
+		rmap_item->mm->ksm_merging_pages--;
 		drop_anon_vma(rmap_item);
 		rmap_item->address &= PAGE_MASK;
 		cond_resched();
@@ -557,6 +575,7 @@ static void remove_rmap_item_from_tree(struct rmap_item *rmap_item)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
+		rmap_item->mm->ksm_merging_pages--;
 
 		drop_anon_vma(rmap_item);
 		rmap_item->address &= PAGE_MASK;
@@ -1137,6 +1156,7 @@ static void stable_tree_append(struct rmap_item *rmap_item,
 		ksm_pages_sharing++;
 	else
 		ksm_pages_shared++;
+	rmap_item->mm->ksm_merging_pages++;
 }
 
 /*
@@ -1382,22 +1402,57 @@ static void ksm_do_scan(unsigned int scan_npages)
 
 static int ksmd_should_run(void)
 {
+	if (ksm_auto && ksm_screen_off)
+		return 0;
 	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list);
 }
 
+/*
+ * At the end of each full scan in automatic mode, slow down if less
+ * than 1% of the pages scanned were merged, and go back to full speed
+ * as soon as a scan does better than that.
+ */
+static void ksm_auto_pace(void)
+{
+	static unsigned long last_seqnr;
+	static unsigned long last_sharing;
+
+	if (ksm_scan.seqnr == last_seqnr)
+		return;
+	last_seqnr = ksm_scan.seqnr;
+
+	ksm_auto_pass_merged = (long)(ksm_pages_sharing - last_sharing);
+	last_sharing = ksm_pages_sharing;
+
+	if (ksm_auto_pass_merged * 100 < (long)ksm_rmap_items) {
+		if (ksm_auto_backoff < KSM_AUTO_MAX_BACKOFF)
+			ksm_auto_backoff <<= 1;
+	} else
+		ksm_auto_backoff = 1;
+}
+
+static unsigned int ksm_sleep_millisecs(void)
+{
+	if (ksm_auto)
+		return ksm_thread_sleep_millisecs * ksm_auto_backoff;
+	return ksm_thread_sleep_millisecs;
+}
+
 static int ksm_scan_thread(void *nothing)
 {
 	set_user_nice(current, 5);
 
 	while (!kthread_should_stop()) {
 		mutex_lock(&ksm_thread_mutex);
-		if (ksmd_should_run())
+		if (ksmd_should_run()) {
 			ksm_do_scan(ksm_thread_pages_to_scan);
+			ksm_auto_pace();
+		}
 		mutex_unlock(&ksm_thread_mutex);
 
 		if (ksmd_should_run()) {
 			schedule_timeout_interruptible(
-				msecs_to_jiffies(ksm_thread_sleep_millisecs));
+				msecs_to_jiffies(ksm_sleep_millisecs()));
 		} else {
 			wait_event_interruptible(ksm_thread_wait,
 				ksmd_should_run() || kthread_should_stop());
@@ -1417,10 +1472,7 @@ int ksm_madvise(struct vm_area_struct *vma, unsigned long start,
 		/*
 		 * Be somewhat over-protective for now!
 		 */
-		if (*vm_flags & (VM_MERGEABLE | VM_SHARED  | VM_MAYSHARE   |
-				 VM_PFNMAP    | VM_IO      | VM_DONTEXPAND |
-				 VM_RESERVED  | VM_HUGETLB | VM_INSERTPAGE |
-				 VM_NONLINEAR | VM_MIXEDMAP | VM_SAO))
+		if (*vm_flags & (VM_MERGEABLE | VM_KSM_UNMERGEABLE))
 			return 0;		/* just ignore the advice */
 
 		if (!test_bit(MMF_VM_MERGEABLE, &mm->flags)) {
@@ -1480,6 +1532,20 @@ int __ksm_enter(struct mm_struct *mm)
 	return 0;
 }
 
+/*
+ * Called at fork in automatic mode: the children of zygote, and any
+ * process forked from them, get all their private anonymous memory
+ * merged.  Zygote is only recognised by its name, which any process
+ * can set with PR_SET_NAME; that gives it nothing it could not get
+ * with MADV_MERGEABLE, since merging only ever shares identical pages.
+ */
+void __ksm_auto_fork(struct mm_struct *mm, struct mm_struct *oldmm)
+{
+	if (test_bit(MMF_VM_MERGE_AUTO, &oldmm->flags) ||
+	    !strcmp(current->comm, "zygote"))
+		set_bit(MMF_VM_MERGE_AUTO, &mm->flags);
+}
+
 void __ksm_exit(struct mm_struct *mm)
 {
 	struct mm_slot *mm_slot;
@@ -1868,6 +1934,47 @@ static ssize_t run_store(struct kobject *kobj, struct kobj_attribute *attr,
 }
 KSM_ATTR(run);
 
+static ssize_t auto_show(struct kobject *kobj, struct kobj_attribute *attr,
+			 char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_auto);
+}
+
+static ssize_t auto_store(struct kobject *kobj, struct kobj_attribute *attr,
+			  const char *buf, size_t count)
+{
+	int err;
+	unsigned long val;
+
+	err = strict_strtoul(buf, 10, &val);
+	if (err || val > 1)
+		return -EINVAL;
+
+	mutex_lock(&ksm_thread_mutex);
+	ksm_auto = val;
+	ksm_auto_backoff = 1;
+	mutex_unlock(&ksm_thread_mutex);
+
+	wake_up_interruptible(&ksm_thread_wait);
+
+	return count;
+}
+KSM_ATTR(auto);
+
+static ssize_t auto_sleep_millisecs_show(struct kobject *kobj,
+					 struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_sleep_millisecs());
+}
+KSM_ATTR_RO(auto_sleep_millisecs);
+
+static ssize_t pass_merged_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%ld\n", ksm_auto_pass_merged);
+}
+KSM_ATTR_RO(pass_merged);
+
 static ssize_t pages_shared_show(struct kobject *kobj,
 				 struct kobj_attribute *attr, char *buf)
 {
@@ -1917,6 +2024,9 @@ static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
 	&run_attr.attr,
+	&auto_attr.attr,
+	&auto_sleep_millisecs_attr.attr,
+	&pass_merged_attr.attr,
 	&pages_shared_attr.attr,
 	&pages_sharing_attr.attr,
 	&pages_unshared_attr.attr,
@@ -1931,6 +2041,25 @@ static struct attribute_group ksm_attr_group = {
 };
 #endif /* CONFIG_SYSFS */
 
+#ifdef CONFIG_HAS_EARLYSUSPEND
+static void ksm_early_suspend(struct early_suspend *h)
+{
+	ksm_screen_off = 1;
+}
+
+static void ksm_late_resume(struct early_suspend *h)
+{
+	ksm_screen_off = 0;
+	wake_up_interruptible(&ksm_thread_wait);
+}
+
+static struct early_suspend ksm_early_suspend_desc = {
+	.level = EARLY_SUSPEND_LEVEL_DISABLE_FB,
+	.suspend = ksm_early_suspend,
+	.resume = ksm_late_resume,
+};
+#endif
+
 static int __init ksm_init(void)
 {
 	struct task_struct *ksm_thread;
@@ -1969,6 +2098,9 @@ static int __init ksm_init(void)
 	 * later callbacks could only be taking locks which nest within that.
 	 */
 	hotplug_memory_notifier(ksm_memory_callback, 100);
+#endif
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	register_early_suspend(&ksm_early_suspend_desc);
 #endif
 	return 0;
 
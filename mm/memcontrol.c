@@ -63,6 +63,13 @@ static int really_do_swap_account __initdata = 1; /* for remember boot option*/
 #define do_swap_account		(0)
 #endif
 
+/*
+ * "memcg_lite" boot option: page cache is not charged, only anonymous and
+ * shmem pages are, and uncharges go through the per-cpu stock like charges
+ * do. Per-app limits then cost little more than the page_cgroup lookup.
+ */
+static int memcg_lite __read_mostly;
+
 /*
  * Per memcg event counter is incremented at every pagein/pageout. This counter
  * is used for trigger some periodic events. This is straightforward and better
@@ -858,6 +865,45 @@ int task_in_mem_cgroup(struct task_struct *task, const struct mem_cgroup *mem)
 	return ret;
 }
 
+/*
+ * Anonymous and shmem pages charged to the memory cgroup of process p, if
+ * p is the only process in it, or 0 otherwise. Lets the lowmemorykiller
+ * see the shmem (ashmem) an app holds, which its rss does not show.
+ *
+ * Shmem cannot be told apart from page cache in the cache statistics,
+ * unless page cache is not charged at all ("memcg_lite"). Without it, only
+ * anonymous pages are counted.
+ *
+ * Must not be called under task_lock(p): cgroup_task_count() takes
+ * css_set_lock, which nests outside of it.
+ */
+unsigned long mem_cgroup_task_pages(struct task_struct *p)
+{
+	struct mem_cgroup *mem;
+	s64 pages = 0;
+
+	if (mem_cgroup_disabled())
+		return 0;
+
+	rcu_read_lock();
+	mem = mem_cgroup_from_task(p);
+	if (mem && (mem_cgroup_is_root(mem) || !css_tryget(&mem->css)))
+		mem = NULL;
+	rcu_read_unlock();
+	if (!mem)
+		return 0;
+
+	/* Every task of the cgroup is a thread of p */
+	if (cgroup_task_count(mem->css.cgroup) == get_nr_threads(p)) {
+		pages = mem_cgroup_read_stat(mem, MEM_CGROUP_STAT_RSS);
+		if (memcg_lite)
+			pages += mem_cgroup_read_stat(mem,
+						      MEM_CGROUP_STAT_CACHE);
+	}
+	css_put(&mem->css);
+	return pages > 0 ? pages : 0;
+}
+
 /*
  * prev_priority control...this will be used in memory reclaim path.
  */
@@ -1530,6 +1576,25 @@ static void refill_stock(struct mem_cgroup *mem, int val)
 	put_cpu_var(memcg_stock);
 }
 
+/*
+ * Give an uncharged page back to the local stock instead of to the
+ * res_counter, when the stock already caches charges of mem and is not
+ * full. Used by the lightweight mode to batch uncharges as well as
+ * charges.
+ */
+static bool uncharge_to_stock(struct mem_cgroup *mem)
+{
+	struct memcg_stock_pcp *stock = &get_cpu_var(memcg_stock);
+	bool ret = false;
+
+	if (stock->cached == mem && stock->charge < CHARGE_SIZE) {
+		stock->charge += PAGE_SIZE;
+		ret = true;
+	}
+	put_cpu_var(memcg_stock);
+	return ret;
+}
+
 /*
  * Tries to drain stocked charges in other cpus. This function is asynchronous
  * and just put a work per cpu for draining localy on each cpu. Caller can
@@ -2037,6 +2102,8 @@ int mem_cgroup_cache_charge(struct page *page, struct mm_struct *mm,
 		return 0;
 	if (PageCompound(page))
 		return 0;
+	if (memcg_lite && page_is_file_cache(page))
+		return 0;
 	/*
 	 * Corner case handling. This is called from add_to_page_cache()
 	 * in usual. But some FS (shmem) precharges this page before calling it
@@ -2229,6 +2296,14 @@ __do_uncharge(struct mem_cgroup *mem, const enum charge_type ctype)
 		batch->memsw_bytes += PAGE_SIZE;
 	return;
 direct_uncharge:
+	/*
+	 * Under OOM the charge has to go back to the res_counter, so that
+	 * the tasks waiting in mem_cgroup_handle_oom() see it freed.
+	 */
+	if (memcg_lite && (uncharge_memsw || !do_swap_account) &&
+	    !test_thread_flag(TIF_MEMDIE) && !atomic_read(&mem->oom_lock) &&
+	    uncharge_to_stock(mem))
+		return;
 	res_counter_uncharge(&mem->res, PAGE_SIZE);
 	if (uncharge_memsw)
 		res_counter_uncharge(&mem->memsw, PAGE_SIZE);
@@ -4646,6 +4721,13 @@ struct cgroup_subsys mem_cgroup_subsys = {
 	.use_id = 1,
 };
 
+static int __init enable_memcg_lite(char *s)
+{
+	memcg_lite = 1;
+	return 1;
+}
+__setup("memcg_lite", enable_memcg_lite);
+
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR_SWAP
 
 static int __init disable_swap_account(char *s)
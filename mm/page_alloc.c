@@ -638,6 +638,90 @@ static void free_one_page(struct zone *zone, struct page *page, int order,
 	spin_unlock(&zone->lock);
 }
 
+static inline int pcp_order_batch(struct per_cpu_pages *pcp, int order)
+{
+	return max(pcp->batch >> order, 1);
+}
+
+/* the boot pagesets have high == 0 and must not keep anything */
+static inline int pcp_order_high(struct per_cpu_pages *pcp, int order)
+{
+	return pcp->high ? 2 * pcp_order_batch(pcp, order) : 0;
+}
+
+/*
+ * Return count blocks of the given order from the pcp lists to the
+ * buddy allocator.  Lists are emptied from the tail, which is where
+ * the coldest blocks are.
+ */
+static void free_pcp_order_bulk(struct zone *zone, int order, int count,
+					struct per_cpu_pages *pcp)
+{
+	struct list_head *lists = pcp->order_lists[order - 1];
+	int migratetype = 0;
+	int to_free = count;
+
+	spin_lock(&zone->lock);
+	zone->all_unreclaimable = 0;
+	zone->pages_scanned = 0;
+
+	while (to_free) {
+		struct page *page;
+		struct list_head *list;
+
+		while (list_empty(&lists[migratetype]))
+			migratetype++;
+		list = &lists[migratetype];
+
+		page = list_entry(list->prev, struct page, lru);
+		list_del(&page->lru);
+		__free_one_page(page, zone, order, page_private(page));
+		trace_mm_page_pcpu_drain(page, order, page_private(page));
+		to_free--;
+	}
+	__mod_zone_page_state(zone, NR_FREE_PAGES, count << order);
+	spin_unlock(&zone->lock);
+
+	pcp->order_count[order - 1] -= count;
+	__count_vm_events(PCP_ORDER_SPILL, count);
+}
+
+static void drain_pcp_orders(struct zone *zone, struct per_cpu_pages *pcp)
+{
+	int order;
+
+	for (order = 1; order <= PCP_MAX_ORDER; order++)
+		if (pcp->order_count[order - 1])
+			free_pcp_order_bulk(zone, order,
+					    pcp->order_count[order - 1], pcp);
+}
+
+/*
+ * Free a block of order 1..PCP_MAX_ORDER onto the pcp lists.  Called
+ * with interrupts disabled, once the pages have been prepared.
+ */
+static void free_pcp_order_page(struct zone *zone, struct page *page,
+				int order, int migratetype)
+{
+	struct per_cpu_pages *pcp;
+
+	/* same rules as free_hot_cold_page() */
+	if (migratetype >= MIGRATE_PCPTYPES) {
+		if (unlikely(migratetype == MIGRATE_ISOLATE)) {
+			free_one_page(zone, page, order, migratetype);
+			return;
+		}
+		migratetype = MIGRATE_MOVABLE;
+	}
+
+	pcp = &this_cpu_ptr(zone->pageset)->pcp;
+	set_page_private(page, migratetype);
+	list_add(&page->lru, &pcp->order_lists[order - 1][migratetype]);
+	if (++pcp->order_count[order - 1] >= pcp_order_high(pcp, order))
+		free_pcp_order_bulk(zone, order, pcp_order_batch(pcp, order),
+				    pcp);
+}
+
 static bool free_pages_prepare(struct page *page, unsigned int order)
 {
 	int i;
@@ -679,7 +763,11 @@ static void __free_pages_ok(struct page *page, unsigned int order)
 	if (unlikely(wasMlocked))
 		free_page_mlock(page);
 	__count_vm_events(PGFREE, 1 << order);
-	free_one_page(page_zone(page), page, order,
+	if (order <= PCP_MAX_ORDER)
+		free_pcp_order_page(page_zone(page), page, order,
+					get_pageblock_migratetype(page));
+	else
+		free_one_page(page_zone(page), page, order,
 					get_pageblock_migratetype(page));
 	local_irq_restore(flags);
 }
@@ -1066,6 +1154,7 @@ void drain_zone_pages(struct zone *zone, struct per_cpu_pages *pcp)
 		to_drain = pcp->count;
 	free_pcppages_bulk(zone, to_drain, pcp);
 	pcp->count -= to_drain;
+	drain_pcp_orders(zone, pcp);
 	local_irq_restore(flags);
 }
 #endif
@@ -1092,6 +1181,7 @@ static void drain_pages(unsigned int cpu)
 		pcp = &pset->pcp;
 		free_pcppages_bulk(zone, pcp->count, pcp);
 		pcp->count = 0;
+		drain_pcp_orders(zone, pcp);
 		local_irq_restore(flags);
 	}
 }
@@ -1310,6 +1400,26 @@ again:
 
 		list_del(&page->lru);
 		pcp->count--;
+	} else if (order <= PCP_MAX_ORDER) {
+		struct per_cpu_pages *pcp;
+		struct list_head *list;
+
+		local_irq_save(flags);
+		pcp = &this_cpu_ptr(zone->pageset)->pcp;
+		list = &pcp->order_lists[order - 1][migratetype];
+		if (list_empty(list)) {
+			pcp->order_count[order - 1] += rmqueue_bulk(zone, order,
+					pcp_order_batch(pcp, order), list,
+					migratetype, 0);
+			if (unlikely(list_empty(list)))
+				goto failed;
+			__count_vm_event(PCP_ORDER_REFILL);
+		}
+
+		page = list_entry(list->next, struct page, lru);
+		list_del(&page->lru);
+		pcp->order_count[order - 1]--;
+		__count_vm_event(PCP_ORDER_ALLOC);
 	} else {
 		if (unlikely(gfp_flags & __GFP_NOFAIL)) {
 			/*
@@ -2033,6 +2143,17 @@ rebalance:
 	if (test_thread_flag(TIF_MEMDIE) && !(gfp_mask & __GFP_NOFAIL))
 		goto nopage;
 
+	/*
+	 * Latency sensitive tasks leave the work to kswapd, which has been
+	 * woken up above, when the allocation is allowed to fail anyway
+	 */
+	if ((p->flags & PF_RECLAIM_FAILFAST) && !(gfp_mask & __GFP_NOFAIL) &&
+	    ((gfp_mask & __GFP_NORETRY) || order > PAGE_ALLOC_COSTLY_ORDER)) {
+		count_vm_event(RECLAIM_FAILFAST);
+		gfp_mask |= __GFP_NOWARN;
+		goto nopage;
+	}
+
 	/* Try direct compaction */
 	page = __alloc_pages_direct_compact(gfp_mask, order,
 					zonelist, high_zoneidx,
@@ -2145,10 +2266,18 @@ __alloc_pages_nodemask(gfp_t gfp_mask, unsigned int order,
 	page = get_page_from_freelist(gfp_mask|__GFP_HARDWALL, nodemask, order,
 			zonelist, high_zoneidx, ALLOC_WMARK_LOW|ALLOC_CPUSET,
 			preferred_zone, migratetype);
-	if (unlikely(!page))
+	if (page && order)
+		compaction_fastpath_alloc(page_zone(page), order);
+	if (unlikely(!page)) {
+		ktime_t start = ktime_get();
+
 		page = __alloc_pages_slowpath(gfp_mask, order,
 				zonelist, high_zoneidx, nodemask,
 				preferred_zone, migratetype);
+		count_vm_event(PGALLOC_SLOW);
+		count_vm_events(PGALLOC_SLOW_USEC,
+				ktime_to_us(ktime_sub(ktime_get(), start)));
+	}
 	put_mems_allowed();
 
 	trace_mm_page_alloc(page, order, gfp_mask, migratetype);
@@ -3361,7 +3490,7 @@ static int zone_batchsize(struct zone *zone)
 static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 {
 	struct per_cpu_pages *pcp;
-	int migratetype;
+	int migratetype, order;
 
 	memset(p, 0, sizeof(*p));
 
@@ -3371,6 +3500,10 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 	pcp->batch = max(1UL, 1 * batch);
 	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
 		INIT_LIST_HEAD(&pcp->lists[migratetype]);
+	for (order = 0; order < PCP_MAX_ORDER; order++)
+		for (migratetype = 0; migratetype < MIGRATE_PCPTYPES;
+		     migratetype++)
+			INIT_LIST_HEAD(&pcp->order_lists[order][migratetype]);
 }
 
 /*
@@ -3478,6 +3611,7 @@ static int __zone_pcp_update(void *data)
 
 		local_irq_save(flags);
 		free_pcppages_bulk(zone, pcp->count, pcp);
+		drain_pcp_orders(zone, pcp);
 		setup_pageset(pset, batch);
 		local_irq_restore(flags);
 	}
@@ -4063,6 +4197,10 @@ static void __paginginit free_area_init_core(struct pglist_data *pgdat,
 	pgdat->nr_zones = 0;
 	init_waitqueue_head(&pgdat->kswapd_wait);
 	pgdat->kswapd_max_order = 0;
+#ifdef CONFIG_COMPACTION
+	init_waitqueue_head(&pgdat->kcompactd_wait);
+	pgdat->kcompactd_max_order = 0;
+#endif
 	pgdat_page_cgroup_init(pgdat);
 	
 	for (j = 0; j < MAX_NR_ZONES; j++) {
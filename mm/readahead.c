@@ -245,10 +245,16 @@ unsigned long max_sane_readahead(unsigned long nr)
 unsigned long ra_submit(struct file_ra_state *ra,
 		       struct address_space *mapping, struct file *filp)
 {
+	int cold = !mapping->nrpages;
 	int actual;
 
 	actual = __do_page_cache_readahead(mapping, filp,
 					ra->start, ra->size, ra->async_size);
+	/* Prefetch behind the read that missed, not ahead of it */
+	if (cold && actual > 0)
+		ra_history_prefetch(mapping, filp);
+	if (actual > 0)
+		ra_history_record(mapping, ra->start, ra->size);
 
 	return actual;
 }
@@ -0,0 +1,216 @@
+/*
+ * mm/readahead_history.c - remember what readahead read from each file
+ *
+ * An app launch reads the same scattered ranges of the same dex, apk and
+ * library files every time, and the on-demand readahead, which only sees
+ * the current stream of reads, takes most of them for random reads.
+ *
+ * So remember the ranges that readahead had to read in from each file
+ * shortly after it was first read with nothing of it cached, keyed by
+ * device and inode number so that the record outlives the inode.  The
+ * next time the file is read cold, read all of them in at once, right
+ * after the read that missed.
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+#include <linux/hash.h>
+#include <linux/jiffies.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/vmstat.h>
+
+#define RA_HISTORY_HASH_BITS	6
+#define RA_HISTORY_EXTENTS	32
+#define RA_HISTORY_GAP		16	/* pages: closer ranges are merged */
+#define RA_HISTORY_MAX_PAGES	1024	/* prefetched per cold start at most */
+#define RA_HISTORY_LAUNCH	(2 * HZ) /* recorded after a cold start */
+
+struct ra_extent {
+	pgoff_t start;
+	unsigned long nr;
+};
+
+struct ra_history {
+	struct hlist_node hash;
+	struct list_head lru;
+	dev_t dev;
+	unsigned long ino;
+	loff_t size;			/* the record is dropped when the */
+	struct timespec mtime;		/* file is changed */
+	unsigned long launch;		/* jiffies of the last cold start */
+	int nr_extents;
+	struct ra_extent extent[RA_HISTORY_EXTENTS];
+};
+
+/* Number of files remembered, 0 to disable */
+int sysctl_readahead_history = 256;
+
+static struct hlist_head ra_history_hash[1 << RA_HISTORY_HASH_BITS];
+static LIST_HEAD(ra_history_lru);
+static int ra_history_count;
+static DEFINE_SPINLOCK(ra_history_lock);
+
+static inline int ra_history_wanted(struct inode *inode)
+{
+	return S_ISREG(inode->i_mode) && inode->i_sb->s_bdev;
+}
+
+static struct hlist_head *ra_history_bucket(struct inode *inode)
+{
+	unsigned long key = inode->i_ino ^ inode->i_sb->s_dev;
+
+	return &ra_history_hash[hash_long(key, RA_HISTORY_HASH_BITS)];
+}
+
+/*
+ * Find the record of an inode, forgetting it if the file has changed
+ * since. Called with ra_history_lock held.
+ */
+static struct ra_history *ra_history_lookup(struct inode *inode)
+{
+	struct ra_history *h;
+	struct hlist_node *node;
+
+	hlist_for_each_entry(h, node, ra_history_bucket(inode), hash) {
+		if (h->ino != inode->i_ino || h->dev != inode->i_sb->s_dev)
+			continue;
+		if (h->size != i_size_read(inode) ||
+		    !timespec_equal(&h->mtime, &inode->i_mtime)) {
+			h->size = i_size_read(inode);
+			h->mtime = inode->i_mtime;
+			h->nr_extents = 0;
+		}
+		list_move(&h->lru, &ra_history_lru);
+		return h;
+	}
+	return NULL;
+}
+
+static void ra_history_add_extent(struct ra_history *h,
+				  pgoff_t start, unsigned long nr)
+{
+	int i;
+
+	for (i = 0; i < h->nr_extents; i++) {
+		struct ra_extent *e = &h->extent[i];
+		pgoff_t end;
+
+		if (start + nr + RA_HISTORY_GAP < e->start ||
+		    start > e->start + e->nr + RA_HISTORY_GAP)
+			continue;
+		end = max(start + nr, e->start + e->nr);
+		e->start = min(start, e->start);
+		e->nr = end - e->start;
+		return;
+	}
+	if (h->nr_extents < RA_HISTORY_EXTENTS) {
+		h->extent[h->nr_extents].start = start;
+		h->extent[h->nr_extents].nr = nr;
+		h->nr_extents++;
+	}
+}
+
+/**
+ * ra_history_record - note a range that readahead read in
+ * @mapping: address_space the pages were read into
+ * @start: first page index of the range
+ * @nr: number of pages in the range
+ *
+ * Only ranges read soon after the file was last read cold are recorded,
+ * so that the record describes what an app launch needs from the file,
+ * not every stream that was ever read from it.
+ */
+void ra_history_record(struct address_space *mapping,
+		       pgoff_t start, unsigned long nr)
+{
+	struct inode *inode = mapping->host;
+	struct ra_history *h;
+
+	if (sysctl_readahead_history <= 0 || !inode ||
+	    !ra_history_wanted(inode))
+		return;
+
+	spin_lock(&ra_history_lock);
+	h = ra_history_lookup(inode);
+	if (h && time_before(jiffies, h->launch + RA_HISTORY_LAUNCH))
+		ra_history_add_extent(h, start, nr);
+	spin_unlock(&ra_history_lock);
+}
+
+/**
+ * ra_history_prefetch - read in what the last cold start read from a file
+ * @mapping: address_space of the file
+ * @filp: file being read
+ *
+ * Called by readahead when it had to read from a file none of which was
+ * cached, which for the files of an app means it is being launched cold.
+ * Starts a new launch window for the file's record, creating the record
+ * if there is none yet.
+ */
+void ra_history_prefetch(struct address_space *mapping, struct file *filp)
+{
+	struct inode *inode = mapping->host;
+	struct ra_extent extent[RA_HISTORY_EXTENTS];
+	struct ra_history *h, *new = NULL;
+	int max = sysctl_readahead_history;
+	unsigned long pages = 0;
+	int i, nr = 0;
+
+	if (max <= 0 || !filp || !inode || !ra_history_wanted(inode) ||
+	    (filp->f_mode & (FMODE_READ | FMODE_WRITE)) != FMODE_READ)
+		return;
+
+again:
+	spin_lock(&ra_history_lock);
+	h = ra_history_lookup(inode);
+	if (h) {
+		nr = h->nr_extents;
+		memcpy(extent, h->extent, nr * sizeof(struct ra_extent));
+	} else {
+		if (!new) {
+			spin_unlock(&ra_history_lock);
+			new = kmalloc(sizeof(*new), GFP_NOFS | __GFP_NOWARN);
+			if (!new)
+				return;
+			goto again;
+		}
+		h = new;
+		new = NULL;
+		h->dev = inode->i_sb->s_dev;
+		h->ino = inode->i_ino;
+		h->size = i_size_read(inode);
+		h->mtime = inode->i_mtime;
+		h->nr_extents = 0;
+		hlist_add_head(&h->hash, ra_history_bucket(inode));
+		list_add(&h->lru, &ra_history_lru);
+		ra_history_count++;
+
+		while (ra_history_count > max) {
+			struct ra_history *old;
+
+			old = list_entry(ra_history_lru.prev,
+					 struct ra_history, lru);
+			hlist_del(&old->hash);
+			list_del(&old->lru);
+			ra_history_count--;
+			kfree(old);
+		}
+	}
+	h->launch = jiffies;
+	spin_unlock(&ra_history_lock);
+
+	kfree(new);
+
+	for (i = 0; i < nr && pages < RA_HISTORY_MAX_PAGES; i++) {
+		unsigned long n = min(extent[i].nr,
+				      RA_HISTORY_MAX_PAGES - pages);
+
+		if (force_page_cache_readahead(mapping, filp,
+					       extent[i].start, n) < 0)
+			break;
+		pages += n;
+	}
+	count_vm_events(RA_HISTORY_PREFETCH, pages);
+}
@@ -189,6 +189,8 @@ void activate_page(struct page *page)
 		lru += LRU_ACTIVE;
 		add_page_to_lru_list(zone, page, lru);
 		__count_vm_event(PGACTIVATE);
+		if (file)
+			workingset_activation(page);
 
 		update_page_reclaim_stat(zone, page, file, 1);
 	}
@@ -40,6 +40,7 @@
 #include <linux/memcontrol.h>
 #include <linux/delayacct.h>
 #include <linux/sysctl.h>
+#include <linux/ktime.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -89,6 +90,10 @@ struct scan_control {
 	 * are scanned.
 	 */
 	nodemask_t	*nodemask;
+
+	/* Latency sensitive caller: no naps, give up at deadline if set */
+	int failfast;
+	ktime_t deadline;
 };
 
 #define lru_to_page(_head) (list_entry((_head)->prev, struct page, lru))
@@ -125,6 +130,8 @@ struct scan_control {
  * From 0 .. 100.  Higher means more swappy.
  */
 int vm_swappiness = 60;
+/* Bound on a PF_RECLAIM_FAILFAST task's direct reclaim, 0 for none */
+int sysctl_direct_reclaim_budget_ms = 20;
 long vm_total_pages;	/* The total number of pages which the VM controls */
 
 static LIST_HEAD(shrinker_list);
@@ -454,6 +461,7 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 		spin_unlock_irq(&mapping->tree_lock);
 		swapcache_free(swap, page);
 	} else {
+		workingset_eviction(mapping, page);
 		__remove_from_page_cache(page);
 		spin_unlock_irq(&mapping->tree_lock);
 		mem_cgroup_uncharge_cache_page(page);
@@ -1859,6 +1867,12 @@ static unsigned long do_try_to_free_pages(struct zonelist *zonelist,
 		if (sc->nr_reclaimed >= sc->nr_to_reclaim)
 			goto out;
 
+		if (sc->failfast && ktime_to_ns(sc->deadline) &&
+		    ktime_to_ns(ktime_sub(ktime_get(), sc->deadline)) >= 0) {
+			count_vm_event(RECLAIM_BUDGET_EXCEEDED);
+			goto out;
+		}
+
 		/*
 		 * Try to write back as many pages as we just scanned.  This
 		 * tends to cause slow streaming writers to write data to the
@@ -1873,7 +1887,7 @@ static unsigned long do_try_to_free_pages(struct zonelist *zonelist,
 		}
 
 		/* Take a nap, wait for some writeback to complete */
-		if (!sc->hibernation_mode && sc->nr_scanned &&
+		if (!sc->hibernation_mode && !sc->failfast && sc->nr_scanned &&
 		    priority < DEF_PRIORITY - 2)
 			congestion_wait(BLK_RW_ASYNC, HZ/10);
 	}
@@ -1913,6 +1927,22 @@ out:
 	return 0;
 }
 
+/*
+ * Sort a direct reclaim stall into the vmstat histogram: buckets are
+ * below 1, 4, 16, 64 and 256ms, and everything slower.
+ */
+static void reclaim_stall_account(u64 delta)
+{
+	enum vm_event_item item = RECLAIM_STALL_1MS;
+	u64 limit = NSEC_PER_MSEC;
+
+	while (item < RECLAIM_STALL_SLOW && delta >= limit) {
+		item++;
+		limit <<= 2;
+	}
+	count_vm_event(item);
+}
+
 unsigned long try_to_free_pages(struct zonelist *zonelist, int order,
 				gfp_t gfp_mask, nodemask_t *nodemask)
 {
@@ -1927,8 +1957,29 @@ unsigned long try_to_free_pages(struct zonelist *zonelist, int order,
 		.mem_cgroup = NULL,
 		.nodemask = nodemask,
 	};
+	struct task_struct *p = current;
+	unsigned long nr_reclaimed;
+	ktime_t start = ktime_get();
+	u64 delta;
+	int budget = sysctl_direct_reclaim_budget_ms;
+
+	if (p->flags & PF_RECLAIM_FAILFAST) {
+		sc.failfast = 1;
+		if (budget > 0)
+			sc.deadline = ktime_add_ns(start,
+					(u64)budget * NSEC_PER_MSEC);
+	}
 
-	return do_try_to_free_pages(zonelist, &sc);
+	nr_reclaimed = do_try_to_free_pages(zonelist, &sc);
+
+	delta = ktime_to_ns(ktime_sub(ktime_get(), start));
+	p->reclaim_stalls++;
+	p->reclaim_stall_ns += delta;
+	if (delta > p->reclaim_stall_max_ns)
+		p->reclaim_stall_max_ns = delta;
+	reclaim_stall_account(delta);
+
+	return nr_reclaimed;
 }
 
 #ifdef CONFIG_CGROUP_MEM_RES_CTLR
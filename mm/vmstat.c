@@ -788,6 +788,24 @@ static const char * const vmstat_text[] = {
 	"allocstall",
 
 	"pgrotated",
+	"pcp_order_alloc",
+	"pcp_order_refill",
+	"pcp_order_spill",
+	"pgalloc_slow",
+	"pgalloc_slow_usec",
+	"workingset_refault",
+	"workingset_activate",
+	"reclaim_stall_lt_1ms",
+	"reclaim_stall_lt_4ms",
+	"reclaim_stall_lt_16ms",
+	"reclaim_stall_lt_64ms",
+	"reclaim_stall_lt_256ms",
+	"reclaim_stall_slower",
+	"reclaim_budget_exceeded",
+	"reclaim_failfast",
+#ifdef CONFIG_READAHEAD_HISTORY
+	"ra_history_prefetch",
+#endif
 
 #ifdef CONFIG_COMPACTION
 	"compact_blocks_moved",
@@ -796,6 +814,8 @@ static const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_daemon_run",
+	"compact_stall_avoided",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
@@ -816,7 +836,7 @@ static const char * const vmstat_text[] = {
 static void zoneinfo_show_print(struct seq_file *m, pg_data_t *pgdat,
 							struct zone *zone)
 {
-	int i;
+	int i, j;
 	seq_printf(m, "Node %d, zone %8s", pgdat->node_id, zone->name);
 	seq_printf(m,
 		   "\n  pages free     %lu"
@@ -859,6 +879,9 @@ static void zoneinfo_show_print(struct seq_file *m, pg_data_t *pgdat,
 			   pageset->pcp.count,
 			   pageset->pcp.high,
 			   pageset->pcp.batch);
+		seq_printf(m, "\n              orders:");
+		for (j = 0; j < PCP_MAX_ORDER; j++)
+			seq_printf(m, " %i", pageset->pcp.order_count[j]);
 #ifdef CONFIG_SMP
 		seq_printf(m, "\n  vm stats threshold: %d",
 				pageset->stat_threshold);
@@ -0,0 +1,215 @@
+/*
+ * Workingset detection
+ *
+ * Page reclaim only sees a page while it is resident, so it cannot tell
+ * a page that is used once from a page that keeps being evicted and read
+ * back in because the inactive file list is too small for the working
+ * set.  To tell the two apart, every page evicted from the file LRU
+ * leaves a shadow entry behind in a table of non-resident pages.  The
+ * entry records the eviction on the zone's inactive_age clock, which
+ * ticks on every eviction and every activation of a file page.
+ *
+ * When the page is read back in, the distance between its eviction and
+ * the refault is the number of pages that were evicted or activated in
+ * the meantime: the minimum by which the inactive list would have had
+ * to be larger for the page to stay resident.  If that is no more than
+ * the number of active file pages, the page could have stayed resident
+ * at the expense of the active list, so it is put straight onto the
+ * active list to compete with the pages there.
+ *
+ * The table is a hash of small buckets, indexed by mapping and offset.
+ * It is lossy: entries are overwritten in turn when a bucket is full,
+ * and are only removed when they refault.  Entries are not removed when
+ * the inode goes away either, so the key also covers the inode number
+ * and generation: an inode allocated at the same address later does not
+ * inherit the shadow entries of the one that was freed.
+ */
+#include <linux/mm.h>
+#include <linux/mmzone.h>
+#include <linux/swap.h>
+#include <linux/fs.h>
+#include <linux/init.h>
+#include <linux/jhash.h>
+#include <linux/bootmem.h>
+#include <linux/spinlock.h>
+#include <linux/vmstat.h>
+
+#define NONRES_BUCKET_ENTRIES	8
+#define NONRES_LOCKS		64
+
+struct nonres_entry {
+	u32 key;		/* hash of mapping, inode and index, 0 if unused */
+	u32 shadow;		/* eviction time and zone */
+};
+
+struct nonres_bucket {
+	struct nonres_entry entry[NONRES_BUCKET_ENTRIES];
+};
+
+static struct nonres_bucket *nonres_table __read_mostly;
+static unsigned int nonres_mask __read_mostly;
+static spinlock_t nonres_locks[NONRES_LOCKS];
+
+#define EVICTION_SHIFT	(NODES_SHIFT + ZONES_SHIFT)
+#define EVICTION_MASK	(~0U >> EVICTION_SHIFT)
+
+static u32 pack_shadow(unsigned long eviction, struct zone *zone)
+{
+	eviction = (eviction << NODES_SHIFT) | zone_to_nid(zone);
+	eviction = (eviction << ZONES_SHIFT) | zone_idx(zone);
+
+	return eviction;
+}
+
+static void unpack_shadow(u32 shadow, struct zone **zone,
+			  unsigned long *eviction)
+{
+	int zid, nid;
+
+	zid = shadow & ((1U << ZONES_SHIFT) - 1);
+	shadow >>= ZONES_SHIFT;
+	nid = shadow & ((1U << NODES_SHIFT) - 1);
+	shadow >>= NODES_SHIFT;
+
+	*zone = NODE_DATA(nid)->node_zones + zid;
+	*eviction = shadow;
+}
+
+static u32 nonres_hash(struct address_space *mapping, pgoff_t index)
+{
+	struct inode *inode = mapping->host;
+	unsigned long m = (unsigned long)mapping;
+	u32 ino = 0, gen = 0;
+	u32 hash;
+
+	if (inode) {
+		ino = inode->i_ino;
+		gen = inode->i_generation;
+	}
+	hash = jhash_3words((u32)m, (u32)((u64)m >> 32) ^ gen, (u32)index, ino);
+
+	return hash ? hash : 1;
+}
+
+/**
+ * workingset_eviction - note the eviction of a page from the page cache
+ * @mapping: address space the page was mapped to
+ * @page: the page being evicted
+ *
+ * Called from reclaim with the mapping's tree_lock held, just before
+ * the page is removed from the page cache.
+ */
+void workingset_eviction(struct address_space *mapping, struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	u32 hash = nonres_hash(mapping, page->index);
+	struct nonres_bucket *bucket;
+	unsigned long eviction;
+	spinlock_t *lock;
+	int i, slot;
+
+	if (!nonres_table)
+		return;
+
+	eviction = atomic_long_inc_return(&zone->inactive_age);
+	bucket = &nonres_table[hash & nonres_mask];
+	lock = &nonres_locks[hash % NONRES_LOCKS];
+	slot = eviction % NONRES_BUCKET_ENTRIES;
+
+	spin_lock(lock);
+	for (i = 0; i < NONRES_BUCKET_ENTRIES; i++) {
+		if (!bucket->entry[i].key) {
+			slot = i;
+			break;
+		}
+	}
+	bucket->entry[slot].key = hash;
+	bucket->entry[slot].shadow = pack_shadow(eviction, zone);
+	spin_unlock(lock);
+}
+
+/**
+ * workingset_refault - check whether a page being read in was recently evicted
+ * @mapping: address space the page is added to
+ * @index: page index within @mapping
+ *
+ * Called with interrupts enabled.  Returns true if the page was evicted
+ * recently enough that it should go straight onto the active list.
+ */
+bool workingset_refault(struct address_space *mapping, pgoff_t index)
+{
+	u32 hash = nonres_hash(mapping, index);
+	struct nonres_bucket *bucket;
+	unsigned long eviction, refault_distance;
+	struct zone *zone;
+	spinlock_t *lock;
+	unsigned long flags;
+	u32 shadow = 0;
+	int i;
+
+	if (!nonres_table)
+		return false;
+
+	bucket = &nonres_table[hash & nonres_mask];
+	lock = &nonres_locks[hash % NONRES_LOCKS];
+
+	/* The eviction side takes the lock under tree_lock, with irqs off */
+	spin_lock_irqsave(lock, flags);
+	for (i = 0; i < NONRES_BUCKET_ENTRIES; i++) {
+		if (bucket->entry[i].key == hash) {
+			shadow = bucket->entry[i].shadow;
+			bucket->entry[i].key = 0;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(lock, flags);
+
+	if (i == NONRES_BUCKET_ENTRIES)
+		return false;
+
+	unpack_shadow(shadow, &zone, &eviction);
+	refault_distance = (atomic_long_read(&zone->inactive_age) - eviction) &
+				EVICTION_MASK;
+
+	count_vm_event(WORKINGSET_REFAULT);
+	if (refault_distance > zone_page_state(zone, NR_ACTIVE_FILE))
+		return false;
+
+	count_vm_event(WORKINGSET_ACTIVATE);
+	atomic_long_inc(&zone->inactive_age);
+	return true;
+}
+
+/**
+ * workingset_activation - note a page activation
+ * @page: page that is being activated
+ */
+void workingset_activation(struct page *page)
+{
+	atomic_long_inc(&page_zone(page)->inactive_age);
+}
+
+static int __init workingset_init(void)
+{
+	struct nonres_bucket *table;
+	unsigned int shift;
+	int i;
+
+	for (i = 0; i < NONRES_LOCKS; i++)
+		spin_lock_init(&nonres_locks[i]);
+
+	/*
+	 * One bucket per 16 pages of memory: enough entries to remember
+	 * about half as many evicted pages as there are resident ones.
+	 */
+	table = alloc_large_system_hash("Non-resident page",
+					sizeof(struct nonres_bucket),
+					0, PAGE_SHIFT + 4, 0,
+					&shift, &nonres_mask, 0);
+	memset(table, 0, sizeof(struct nonres_bucket) * (nonres_mask + 1));
+
+	smp_wmb();
+	nonres_table = table;
+	return 0;
+}
+module_init(workingset_init)